@@ -1,59 +1,40 @@
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <algorithm>
 #include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
 #include "chess.hpp"
 #include <string>
 #include <unordered_map>
 #include <cmath>
 #include <stdexcept>
 #include "tt.hpp"
-
-static U64 count = 0;
-static U64 mates = 0;
-static U64 collision = 0;
-static U64 hitCount = 0;
-static U64 maxDepth = 0;
+#include "scheduler.hpp"
 
 static constexpr int CHECKMATE = 10000000;
 
-template <typename T, size_t Size>
-class CircularArray
-{
-private:
-  size_t currentIndex;
-
-public:
-  T array[Size];
-
-  CircularArray() : currentIndex(0) {}
-
-  void addElement(const T &element)
-  {
-    array[currentIndex] = element;
-    currentIndex = (currentIndex + 1) % Size;
-  }
-
-  void empty()
-  {
-    currentIndex = 0;
-    std::fill(std::begin(array), std::end(array), T());
-  }
-};
-
 namespace Chess5D
 {
   static constexpr int MAX_PLY = 30;
   static constexpr int PLY = 20;
+  static constexpr int MOVESET_WIDTH = 4;   // Most moves a timeline contributes to the movesets searched
+  static constexpr int MOVESET_MARGIN = 25; // Moves scoring further below a timeline's best are left out
+  static constexpr int ASPIRATION_WINDOW = 25; // Half width of the first window around the previous iteration's score
+  static constexpr int MIN_SPLIT_DEPTH = 4; // Nodes shallower than this are not worth replaying the path to for
+  static constexpr U64 POLL_NODES = 1024; // Nodes between two checks of the search limits, a power of two
+  static constexpr int KILLER_PLIES = MAX_PLY + 1; // Deeper plies share the last killer slots
+  static constexpr int PV_PLIES = MAX_PLY + 2; // Nodes past MAX_PLY only quiesce, which leaves its lines empty
+  static constexpr int PV_MOVES = 256; // Moves a line holds, movesets that no longer fit are cut off
+  static constexpr bool TRAVEL_MOBILITY = true; // Whether travels count towards mobility, otherwise they are only generated to tell mate from softmate
+  static constexpr int PV_SCORE = 1 << 30; // Orders the TT move ahead of everything moveScore can produce
   static constexpr int NUM_PIECES = 12;
   static constexpr int BOARD_SIZE = 8;
 
-  int typeToVal[NUM_PIECES] = {1, 5, 5, 3, 15, 0, 9, 4, 0, 3, 2, .25};
-
-  // Move lbrTable[NUM_PIECES * 2 + 1][BOARD_SIZE][BOARD_SIZE]; // should really not be +1 but travels exist
-
-  CircularArray<Move, 8> killerTable;
-
-  TranspositionTable tt(1000000);
+  TranspositionTable tt(64); // MB, the table searches share unless given their own
+  EvalCache evalCache(4);     // MB, shared by every search
 
   // Move mateKiller[PLY][10];
 
@@ -63,47 +44,228 @@ namespace Chess5D
     NodeTravel
   };
 
+  // How negaMaxIDDFS uses its threads on a single timeline, a multiverse always splits its root timelines
+  enum ParallelMode : U8
+  {
+    ParallelLazySMP,
+    ParallelYBW
+  };
+
+  // A principal variation, one moveset per ply stored back to back
+  struct PVLine
+  {
+    Move moves[PV_MOVES];
+    U8 sizes[PV_PLIES]; // Moves in each moveset
+    U16 length = 0;     // Moves in the whole line
+    U8 plies = 0;
+
+    // This line becomes `moveset` followed by as much of `rest` as fits
+    void set(const Move *moveset, int size, const PVLine &rest)
+    {
+      std::memcpy(moves, moveset, size * sizeof(Move));
+      sizes[0] = size;
+      int restLength = 0;
+      int restPlies = 0;
+      while (restPlies < rest.plies && restPlies + 1 < PV_PLIES && size + restLength + rest.sizes[restPlies] <= PV_MOVES)
+        restLength += rest.sizes[restPlies++];
+      std::memcpy(moves + size, rest.moves, restLength * sizeof(Move));
+      std::memcpy(sizes + 1, rest.sizes, restPlies);
+      length = size + restLength;
+      plies = restPlies + 1;
+    }
+  };
+
+  // Triangular PV table: line `ply` is the best line found below the node searched at that ply. Every node empties its
+  // line on entry and copies its child's behind the move that raised alpha, so the search never allocates for it.
+  struct PVTable
+  {
+    PVLine lines[PV_PLIES];
+
+    void clear(int ply)
+    {
+      if (ply < PV_PLIES)
+        lines[ply].length = lines[ply].plies = 0;
+    }
+
+    void update(int ply, const Move *moveset, int size) { lines[ply].set(moveset, size, lines[ply + 1]); }
+  };
+
   struct Result
   {
-    int value;
-    std::vector<Chess5D::Move> moveset;
-    std::unique_ptr<Result> next;
+    int value = 0;
+    std::vector<Chess5D::Move> moveset; // Best moveset, empty if the search had no time to find one
+    PVLine pv;                          // Principal variation, starting with moveset
+  };
+
+  // When negaMaxIDDFS stops. No new iteration starts after the soft time, searching stops altogether at the hard time or
+  // once the calling thread has searched `nodes` nodes. A depth or node limit alone gives reproducible searches.
+  struct SearchLimits
+  {
+    int depth = MAX_PLY;
+    std::chrono::milliseconds softTime = std::chrono::milliseconds::max();
+    std::chrono::milliseconds hardTime = std::chrono::milliseconds::max();
+    U64 nodes = 0; // 0 for no limit
+  };
+
+  // Everything a search thread reads and writes besides the position, so that several searches can run in one process.
+  // The threads of one search share the owner's table, stop flag and scheduler, and keep their own move ordering tables
+  // and counters.
+  struct SearchContext
+  {
+    TranspositionTable &tt;
+    EvalCache &evalCache;
+    SearchContext *owner;              // The context of the thread that started the search, itself for that thread
+    Scheduler *scheduler = nullptr;    // Set while the search runs on several threads other than Lazy SMP helpers
+    bool splitting = false;            // Whether negaMax1 splits nodes Young Brothers Wait style, otherwise the
+                                       // scheduler only spreads the root timelines of a multiverse
+    std::atomic<bool> stopped{false};  // Only the owner's is read, helpers unwind without storing anything once set
+    const SplitPoint *split = nullptr; // The split point this thread is searching below
+
+    // Every scheduler worker keeps one context and one multiverse at the root for the whole search, split points only
+    // hand out the moves leading from the root to them
+    std::vector<SearchContext *> workers; // The owner's, by scheduler worker id, itself first
+    void *position = nullptr;             // The Chess this thread searches on, of the search's type
+    int height = 0;                       // Ply `position` is at while the thread waits for a split point
+    Move path[MAX_PLY + 1];               // Moves made on the way to the node searched at each ply
+
+    // Quiet moves that caused beta cutoffs, see rewardQuiet. Pieces index from 0 to NoPiece, the last being the piece
+    // of a null move.
+    Move killers[KILLER_PLIES][2] = {};
+    int history[NoPiece + 1][64] = {};      // By moving piece and destination square
+    Move counterMoves[NoPiece + 1][64] = {}; // By piece and destination square of the move being answered
+
+    PVTable pv;
+
+    // Hard limits, only the owner's are read and they are set before any helper starts
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    U64 nodeLimit = 0; // Node count of the owner to stop at, 0 for none
+
+    U64 count = 0; // Evaluations
+    U64 nodes = 0;
+    U64 mates = 0;
+    U64 collision = 0;
+    U64 hitCount = 0;
+    U64 evalHits = 0; // Evaluations answered by the eval cache
+
+    explicit SearchContext(TranspositionTable &tt, EvalCache &evalCache = Chess5D::evalCache) : tt(tt), evalCache(evalCache), owner(this) {}
+
+    // A context for a thread helping the search of `other`
+    explicit SearchContext(SearchContext &other) : tt(other.tt), evalCache(other.evalCache), owner(other.owner), scheduler(other.scheduler), splitting(other.splitting) {}
+
+    // Searches are abandoned once the search is stopped or a split point above them failed high
+    bool aborted() const
+    {
+      return owner->stopped.load(std::memory_order_relaxed) || (split && split->cancelled());
+    }
+
+    // Called every POLL_NODES nodes, stops the whole search once a hard limit is reached
+    void poll()
+    {
+      if ((this == owner && nodeLimit && nodes >= nodeLimit) || std::chrono::steady_clock::now() >= owner->deadline)
+        owner->stopped = true;
+    }
+
+    const Move *killersAt(int ply) const { return killers[std::min(ply, KILLER_PLIES - 1)]; }
+
+    // The quiet move `move` of `piece` failed high at `ply` with `depth` left, `counter` is the counter move slot of the
+    // move it answered
+    void rewardQuiet(const Move &move, Piece piece, int ply, int depth, Move &counter)
+    {
+      Move *slots = killers[std::min(ply, KILLER_PLIES - 1)];
+      if (slots[0] != move)
+      {
+        slots[1] = slots[0];
+        slots[0] = move;
+      }
+      history[piece][move.to] += depth * depth;
+      counter = move;
+    }
+
+    // Cutoffs of earlier iterations count for half as much as those of the current one
+    void ageHistory()
+    {
+      for (auto &row : history)
+        for (int &value : row)
+          value /= 2;
+    }
 
-    Result(int v, std::vector<Chess5D::Move> m, std::unique_ptr<Result> n) : value(v), moveset(m), next(std::move(n)) {}
+    void clearOrdering()
+    {
+      std::fill(&killers[0][0], &killers[0][0] + KILLER_PLIES * 2, Move());
+      std::fill(&history[0][0], &history[0][0] + (NoPiece + 1) * 64, 0);
+      std::fill(&counterMoves[0][0], &counterMoves[0][0] + (NoPiece + 1) * 64, Move());
+    }
+
+    void resetStats()
+    {
+      count = nodes = mates = collision = hitCount = evalHits = 0;
+    }
 
-    Result() : value(0), moveset(), next(nullptr) {}
+    void addStats(const SearchContext &helper)
+    {
+      count += helper.count;
+      nodes += helper.nodes;
+      mates += helper.mates;
+      collision += helper.collision;
+      hitCount += helper.hitCount;
+      evalHits += helper.evalHits;
+    }
+  };
+
+  struct EvalWeights
+  {
+    int softmate = -10000;
+    double pieceVal = 5;
+    double moveVal = 1;
+    double kingExp = 1;
+    int tlValue = -2000;
+    int unmoved = 5;
+    int psq = 1;
   };
 
   template <U8 Set, U8 Size, U16 L, U16 T, bool White>
-  _Compiletime int evaluate(Chess<Set, Size, L, T> &chess, int timeline, int depth)
+  _Compiletime int evaluate(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int timeline, int depth)
   {
-    struct Weight
-    {
-      int softmate = -10000;
-      double pieceVal = 5;
-      double moveVal = 1;
-      double kingExp = 1;
-      int tlValue = -2000;
-      int unmoved = 5;
-    } w;
-
-    ++count;
-    std::vector<Chess5D::Move> moves;
-    moves.reserve(100);
-    chess.template generateMoves<White>(moves, timeline);
+    constexpr EvalWeights w{};
+
+    ++ctx.count;
+    const U64 key = ctx.tt.computeHashKey<White>(chess, timeline);
+    int cached;
+    if (ctx.evalCache.probe(key, cached))
+    {
+      ++ctx.evalHits;
+      return cached;
+    }
+
+    MoveList<> moves;
+    chess.template generateMoves<White, TRAVEL_MOBILITY ? GenAll : GenSpatial>(moves, timeline);
+    if (!TRAVEL_MOBILITY && moves.size() == 0)
+      chess.template generateMoves<White>(moves, timeline);
     if (moves.size() == 0)
     {
-      ++mates;
+      ++ctx.mates;
       return -CHECKMATE + depth;
     }
 
     TimelineInfo info = chess.timelineInfo[timeline];
-    Board<Set> brd = chess.boards[timeline][info.turn];
+    const Board<Set> &brd = chess.boards[timeline][info.turn];
+
+#ifdef NNUE
+    // A loaded network replaces the hand-written terms, only mates are still found by generating moves
+    if (network.loaded)
+    {
+      const U64 past = brd.pastMask.center | brd.pastMask.north | brd.pastMask.east | brd.pastMask.south | brd.pastMask.west |
+                       brd.pastMask.northeast | brd.pastMask.southeast | brd.pastMask.southwest | brd.pastMask.northwest;
+      const int value = (White ? 1 : -1) * network.evaluate(brd.board.hidden, past, chess.timelineNum[1] - chess.timelineNum[0]);
+      ctx.evalCache.store(key, value);
+      return value;
+    }
+#endif
 
     double eval = 0;
 
     // Move Count
-     eval += w.moveVal * (moves.size());
+    eval += w.moveVal * (moves.size());
 
     // Softmate
     if (std::all_of(moves.begin(), moves.end(), [](const Move &move)
@@ -112,20 +274,9 @@ namespace Chess5D
       eval += w.softmate;
     }
 
-    // Piece Count
-    for (int i = 0; i < 12; ++i)
-    {
-
-      U64 pieceW = brd.bitBoard(White, static_cast<PieceType>(i));
-      U64 pieceB = brd.bitBoard(!White, static_cast<PieceType>(i));
-      eval += w.pieceVal * typeToVal[i] * (_popcnt64(pieceW) - _popcnt64(pieceB));
-
-      // Castle Ability Bonus
-      if (i == 5 || i == 3)
-      {
-        eval += w.unmoved * (_popcnt64(pieceW & brd.board.unmoved) - _popcnt64(pieceB & brd.board.unmoved));
-      }
-    }
+    // Piece Count, castle ability and piece squares, summed up by the boards as pieces move
+    const Accumulator &sums = brd.board.sums;
+    eval += (White ? 1 : -1) * (w.pieceVal * sums.material + w.unmoved * sums.castling + w.psq * sums.psq);
 
     bool enemyHasQueen = (brd.bitBoard(!White, Queen) | brd.bitBoard(!White, RQueen) | brd.bitBoard(!White, Unicorn) | brd.bitBoard(!White, Dragon)) > 0;
     bool enemyHasBishop = enemyHasQueen || ((brd.bitBoard(!White, Bishop) | brd.bitBoard(!White, Princess)) > 0);
@@ -136,7 +287,7 @@ namespace Chess5D
     // Timeline Count
     eval += w.tlValue * ((chess.timelineNum[White]) - (chess.timelineNum[!White]));
 
-    Board<Set> brd2 = chess.boards[timeline][info.turn - 1];
+    const Board<Set> &brd2 = chess.boards[timeline][info.turn - 1];
 
     U64 combinedMask = brd.pastMask.center |
                                (enemyHasBishop)
@@ -157,13 +308,76 @@ namespace Chess5D
     // KingExposure
     eval += w.kingExp * (std::max(0, (int)_popcnt64(combinedMask2) - 4) - std::max(0, (int)_popcnt64(combinedMask) - 4)); // not really working as intended
 
+    // Mates are not cached, their score depends on the depth
+    ctx.evalCache.store(key, eval);
     return eval;
   };
 
+  typedef double F64x8 __attribute__((vector_size(64))); // The lanes of a U512 as doubles
+
+  // The terms of evaluate that need no move generation, for every active timeline at once and summed the way the
+  // multiverse leaf sums its timelines. Eight head boards at a time are gathered into U512 lanes. Mobility, softmate
+  // and mates are left out, so it is no bound on what the leaf's quiescence searches return.
   template <U8 Set, U8 Size, U16 L, U16 T, bool White>
-  _Compiletime void moveScore(Chess<Set, Size, L, T> &chess, int depth, int timeline, Move &move, Move &lastMove)
+  _Compiletime int evaluateStatic(const Chess<Set, Size, L, T> &chess)
+  {
+    constexpr EvalWeights w{};
+    const int first = chess.origIndex[1] - chess.activeNum[1];
+    const int last = chess.origIndex[0] + chess.activeNum[0];
+    const double timelines = (White ? 1 : -1) * (chess.timelineNum[1] - chess.timelineNum[0]);
+
+    F64x8 eval{};
+    for (int base = first; base <= last; base += 8)
+    {
+      // Square sets of the board to move and of the one before it, lanes past the last timeline stay empty
+      U512 centre{}, orth{}, diag{}, bishop{}, queen{};
+      U512 centre2{}, orth2{}, diag2{}, bishop2{}, queen2{};
+      F64x8 sums{}, present{};
+      for (int i = 0; i < 8 && base + i <= last; ++i)
+      {
+        const TimelineInfo &info = chess.timelineInfo[base + i];
+        const Board<Set> &brd = chess.boards[base + i][info.turn];
+        const Board<Set> &brd2 = chess.boards[base + i][info.turn - 1];
+        const Accumulator &acc = brd.board.sums;
+        sums[i] = (White ? 1 : -1) * (w.pieceVal * acc.material + w.unmoved * acc.castling + w.psq * acc.psq);
+        present[i] = 1;
+
+        centre[i] = brd.pastMask.center;
+        orth[i] = brd.pastMask.north | brd.pastMask.south;
+        diag[i] = brd.pastMask.northeast | brd.pastMask.southeast | brd.pastMask.southwest | brd.pastMask.northwest;
+        queen[i] = brd.bitBoard(!White, Queen) | brd.bitBoard(!White, RQueen) | brd.bitBoard(!White, Unicorn) | brd.bitBoard(!White, Dragon);
+        bishop[i] = queen[i] | brd.bitBoard(!White, Bishop) | brd.bitBoard(!White, Princess);
+
+        centre2[i] = brd2.pastMask.center;
+        orth2[i] = brd2.pastMask.north | brd2.pastMask.south;
+        diag2[i] = brd2.pastMask.northeast | brd2.pastMask.southeast | brd2.pastMask.southwest | brd2.pastMask.northwest;
+        queen2[i] = brd2.bitBoard(White, Queen) | brd2.bitBoard(White, RQueen) | brd2.bitBoard(White, Unicorn) | brd2.bitBoard(White, Dragon);
+        bishop2[i] = queen2[i] | brd2.bitBoard(White, Bishop) | brd2.bitBoard(White, Princess);
+      }
+
+      // Lines only count when the other side has a piece moving along them
+      const U512 none{};
+      const U512 exposed = centre | ((bishop != none) & (orth | ((queen != none) & diag)));
+      const U512 exposed2 = centre2 | ((bishop2 != none) & (orth2 | ((queen2 != none) & diag2)));
+      F64x8 kingExp{};
+      for (int i = 0; i < 8; ++i)
+        kingExp[i] = std::max(0, std::popcount(exposed2[i]) - 4) - std::max(0, std::popcount(exposed[i]) - 4);
+
+      eval += sums + w.kingExp * kingExp + w.tlValue * timelines * present;
+    }
+
+    double total = 0;
+    for (int i = 0; i < 8; ++i)
+      total += eval[i];
+    return total;
+  }
+
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  _Compiletime void moveScore(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int depth, int ply, int timeline, const Move &move, const Move &lastMove, const CheckInfo &checkInfo, int &score, int &E)
   {
     // should score with MVV-LVA, piece square table difference, captures/promotions, check caused
+    score = 0;
+    E = 0;
     TimelineInfo info = chess.timelineInfo[timeline];
     Board<Set> &brd = chess.boards[timeline][info.turn];
 
@@ -175,213 +389,519 @@ namespace Chess5D
     {
       if (chess.timelineNum[White] > chess.timelineNum[!White])
       {
-        move.score -= 1000;
-        move.E -= 1;
+        score -= 1000;
+        E -= 1;
       }
       if (move.type == Travel)
       {
-        move.score -= 200;
-        move.E -= 1;
+        score -= 200;
+        E -= 1;
       }
-      move.score -= 200; // travel penalty
+      score -= 200; // travel penalty
 
       Board<Set> &brdTravel = chess.boards[move.eTimeline][move.eTurn];
       pieceTo = brdTravel.board.mailboxBoard[move.to];
     }
     else
     {
-      /*
-      if (lastMove.type != NullMove) { // LBR
-        Piece lastPieceFrom = brd.board.mailboxBoard[lastMove.to];
-        if (lbrTable[lastPieceFrom][lastMove.from][lastMove.to] == move) {
-          move.score += 20;
-        };
-      }
-      */
-
-      // minimal benefits when set to 0 eval???
-      for (Move &killMove : killerTable.array)
-      { // Killer
-        if (killMove == move)
-        {
-          move.score += 1000;
-          break;
-        }
-      }
+      const Move *killers = ctx.killersAt(ply);
+      if (move == killers[0] || move == killers[1])
+        score += 1000;
     }
 
     if (move.type == Capture || move.type == PromoCapture || move.type == TravelCapture || move.type == TravelPromoCapture)
     {
-      move.score += typeToVal[pieceTo] * 2 - typeToVal[pieceFrom] + 10; // MVV-LVA //TODO: Improve
+      score += typeToVal[pieceTo >> 1] * 2 - typeToVal[pieceFrom >> 1] + 10; // MVV-LVA, indexed by piece type //TODO: Improve
     }
     else
     {
-      move.score -= typeToVal[pieceFrom]; // probably needs fixing but works well ¯\_(ツ)_/¯
+      score -= typeToVal[pieceFrom >> 1]; // probably needs fixing but works well ¯\_(ツ)_/¯
     }
 
-    chess.template makeMove<White>(move);
-    Board<Set> &newBrd = chess.boards[timeline][info.turn + 1];
-    if (newBrd.checkMask != FULL)
+    if (chess.template givesCheck<White>(move, checkInfo))
     {
-      move.score += 100; // Check incentive
-      move.E += 1;
+      score += isTravel ? 400 : 100; // (Travel) Check incentive
+      E += isTravel ? 2 : 1;
     }
-    if (isTravel)
+  };
+
+  // Depth extension for checks given by a move that was just made from headboard `turn` of `timeline`
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  _Compiletime int checkExtension(Chess<Set, Size, L, T> &chess, int timeline, int turn, const Move &move)
+  {
+    int E = chess.boards[timeline][turn + 1].checkMask != FULL ? 1 : 0;
+    if (move.type >= Travel)
     {
       int newTimeline = chess.origIndex[White] + (White ? -1 : 1) * (chess.timelineNum[White]);
-      Board<Set> &newBrdTravel = chess.boards[newTimeline][move.eTurn + 1];
-      if (newBrdTravel.checkMask != FULL)
+      if (chess.boards[newTimeline][move.eTurn + 1].checkMask != FULL)
+        E += 2;
+    }
+    return E;
+  }
+
+  // Moves the killer, history and counter move tables learn from, the ones MovePicker puts after the captures
+  _Compiletime bool isQuiet(const Move &move)
+  {
+    return move.type < Travel && move.type != Capture && move.type != PromoCapture;
+  }
+
+  // The counter move slot answering `lastMove`, which was just played onto `brd`. Travels and null moves share a row.
+  template <U8 Set>
+  _Compiletime Move &counterSlot(SearchContext &ctx, const Board<Set> &brd, const Move &lastMove)
+  {
+    const Piece piece = lastMove.type < Travel ? brd.board.mailboxBoard[lastMove.to] : NoPiece;
+    return ctx.counterMoves[piece][lastMove.to];
+  }
+
+  enum PickStage : U8
+  {
+    StageTT,
+    StageCaptures,
+    StageKillers,
+    StageQuiets,
+    StageTravels,
+    StageDone
+  };
+
+  // Hands out moves in the order TT move, captures by MVV-LVA, killers and the counter move, quiets by history and travels.
+  // A stage is only split off the list and scored once the previous one is exhausted, and the best move of a stage
+  // is selected when it is asked for, so a cutoff on the first moves leaves the rest of the list untouched.
+  // The stages come from one generated list rather than being generated one by one: the TT move is only known to be
+  // legal once found among the generated moves, and the pins, past checks and travel masks serve every stage.
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  struct MovePicker
+  {
+    Chess<Set, Size, L, T> &chess;
+    MoveList<> &moves;
+    const Board<Set> &brd;
+    const Move *ttMove;
+    const SearchContext &ctx;
+    const Move *killers;
+    const Move counter;
+    U8 stage = StageTT;
+    U16 cur = 0;
+    U16 stageEnd = 0;
+
+    MovePicker(Chess<Set, Size, L, T> &chess, MoveList<> &moves, int timeline, const Move *ttMove, const SearchContext &ctx, int ply, const Move &counter)
+        : chess(chess), moves(moves), brd(chess.boards[timeline][chess.timelineInfo[timeline].turn]), ttMove(ttMove), ctx(ctx),
+          killers(ctx.killersAt(ply)), counter(counter) {}
+
+    // Writes the next move and its extension, returns false once every move has been handed out
+    _Compiletime bool next(Move &move, int &E)
+    {
+      while (cur == stageEnd)
       {
-        move.score += 400; // Travel Check incentive
-        move.E += 2;
+        if (stage == StageDone)
+          return false;
+        nextStage();
       }
+
+      U16 best = cur;
+      for (U16 i = cur + 1; i < stageEnd; ++i)
+        if (moves.scores[i] > moves.scores[best])
+          best = i;
+
+      std::swap(moves[cur], moves[best]);
+      std::swap(moves.scores[cur], moves.scores[best]);
+      std::swap(moves.extensions[cur], moves.extensions[best]);
+
+      move = moves[cur];
+      E = moves.extensions[cur++];
+      return true;
     }
 
-    chess.template undoMove<White>(move);
+  private:
+    _Compiletime bool isKiller(const Move &move) const
+    {
+      return move == killers[0] || move == killers[1] || move == counter;
+    }
+
+    // Moves the current stage's moves to the front of the unpicked range and scores them
+    template <typename Pred, typename Score>
+    _Compiletime void split(Pred pred, Score score)
+    {
+      stageEnd = std::partition(moves.begin() + cur, moves.end(), pred) - moves.begin();
+      for (U16 i = cur; i < stageEnd; ++i)
+      {
+        moves.extensions[i] = 0;
+        moves.scores[i] = score(moves[i], moves.extensions[i]);
+      }
+    }
+
+    _Compiletime void nextStage()
+    {
+      switch (stage++)
+      {
+      case StageTT:
+        if (ttMove)
+          split([&](const Move &move) { return move == *ttMove; }, [](const Move &, int &) { return PV_SCORE; });
+        break;
+      case StageCaptures:
+        split([](const Move &move) { return move.type == Capture || move.type == PromoCapture; },
+              [&](const Move &move, int &)
+              { return typeToVal[brd.board.mailboxBoard[move.to] >> 1] * 2 - typeToVal[brd.board.mailboxBoard[move.from] >> 1] + 10; }); // MVV-LVA
+        break;
+      case StageKillers:
+        split([&](const Move &move) { return move.type < Travel && isKiller(move); },
+              [&](const Move &move, int &) { return move == killers[0] ? 2 : move == killers[1]; });
+        break;
+      case StageQuiets:
+        split([](const Move &move) { return move.type < Travel; },
+              [&](const Move &move, int &)
+              {
+                const Piece piece = brd.board.mailboxBoard[move.from];
+                return ctx.history[piece][move.to] - typeToVal[piece >> 1]; // Cheaper pieces first until there is a history
+              });
+        break;
+      case StageTravels:
+        split([](const Move &) { return true; },
+              [&](const Move &move, int &E)
+              {
+                if (chess.timelineNum[White] > chess.timelineNum[!White])
+                  E -= 1;
+                if (move.type == Travel)
+                  E -= 1;
+
+                const Piece pieceFrom = brd.board.mailboxBoard[move.from];
+                if (move.type == TravelCapture || move.type == TravelPromoCapture)
+                  return typeToVal[chess.boards[move.eTimeline][move.eTurn].board.mailboxBoard[move.to] >> 1] * 2 - typeToVal[pieceFrom >> 1] + 10;
+                return -typeToVal[pieceFrom >> 1] - (move.type == Travel ? 200 : 0);
+              });
+        break;
+      }
+    }
+  };
+
+  // Moves of one timeline, best first, with the values searching them returned
+  struct TimelineMoves
+  {
+    std::vector<Move> moves;
+    std::vector<int> scores;
   };
 
-  void generateCombinations(const std::vector<std::vector<Move>> &moveList, int depth, std::vector<Move> &currentCombination, int x, std::vector<std::vector<Move>> &resList)
+  // Yields the movesets of a multiverse turn, one move per timeline, by descending summed score without building them
+  // all up front. Every timeline only contributes the moves within MOVESET_MARGIN of its best, at most MOVESET_WIDTH,
+  // so a timeline with one clear best move does not multiply the count.
+  // Index tuples are expanded from a priority queue. A tuple's successors only advance the timeline it was reached by
+  // or later ones, which reaches every tuple exactly once.
+  class MovesetEnumerator
+  {
+    struct Candidate
+    {
+      int score;
+      U32 tuple; // Offset of its indices in `tuples`
+      U16 pivot; // Timeline advanced last
+      bool operator<(const Candidate &other) const { return score < other.score; }
+    };
+
+    const std::vector<TimelineMoves> &timelines;
+    std::vector<U8> widths;
+    std::vector<U8> tuples;
+    std::priority_queue<Candidate> queue;
+
+  public:
+    MovesetEnumerator(const std::vector<TimelineMoves> &timelines) : timelines(timelines)
+    {
+      int score = 0;
+      for (const TimelineMoves &timeline : timelines)
+      {
+        U8 width = 0;
+        while (width < MOVESET_WIDTH && width < timeline.moves.size() && timeline.scores[width] >= timeline.scores[0] - MOVESET_MARGIN)
+          ++width;
+        if (width == 0) // No moves on a timeline means no movesets at all
+          return;
+        widths.push_back(width);
+        score += timeline.scores[0];
+      }
+      tuples.resize(timelines.size(), 0);
+      queue.push({score, 0, 0});
+    }
+
+    // Writes the next best moveset, returns false once every one has been handed out
+    bool next(std::vector<Move> &moveset)
+    {
+      if (queue.empty())
+        return false;
+      const Candidate best = queue.top();
+      queue.pop();
+
+      moveset.clear();
+      for (int i = 0; i < timelines.size(); ++i)
+        moveset.push_back(timelines[i].moves[tuples[best.tuple + i]]);
+
+      for (U16 i = best.pivot; i < timelines.size(); ++i)
+      {
+        const U8 index = tuples[best.tuple + i];
+        if (index + 1 >= widths[i])
+          continue;
+        const U32 tuple = tuples.size();
+        tuples.insert(tuples.end(), tuples.begin() + best.tuple, tuples.begin() + best.tuple + timelines.size());
+        tuples[tuple + i] = index + 1;
+        queue.push({best.score - timelines[i].scores[index] + timelines[i].scores[index + 1], tuple, i});
+      }
+      return true;
+    }
+  };
+
+  // Orders the moves of one timeline by the value of a full window search below each of them
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  TimelineMoves searchTimeline(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int alpha, int beta, int depth, int ply, int timeline)
   {
-    if (depth == moveList.size())
+    MoveList<> moves;
+    chess.template generateMoves<White>(moves, timeline);
+
+    // Score
+    const Move tempNullMove = Move(0, 0, 0, 0, NullMove, 0, 0, 0, 0);
+    const CheckInfo checkInfo = chess.template checkInfo<White>(timeline);
+    for (int j = 0; j < moves.size(); ++j)
     {
-      // Add the current combination to allCombinations
-      resList.push_back(currentCombination);
-      return;
+      moveScore<Set, Size, L, T, White>(ctx, chess, depth, ply, timeline, moves[j], tempNullMove, checkInfo, moves.scores[j], moves.extensions[j]);
+    }
+
+    // Sort
+    moves.sortByScore();
+
+    // Search
+    for (int j = 0; j < moves.size(); ++j)
+    { // could maybe add alpha beta cutoffs at this depth
+      const Move &move = moves[j];
+      chess.template makeMove<White>(move);
+      int res = negaMax1<Set, Size, L, T, !White, false, NodeSpatial>(ctx, chess, -beta, -alpha, depth - 1, ply+1, timeline, move);
+      chess.template undoMove<White>(move);
+
+      moves.scores[j] = -res;
     }
 
-    for (int i = 0; i < x && i < moveList[depth].size(); ++i)
+    // Resort
+    moves.sortByScore();
+    return {std::vector<Chess5D::Move>(moves.begin(), moves.end()), std::vector<int>(moves.scores, moves.scores + moves.size())};
+  }
+
+  // Lazy SMP helper: iterative deepening on its own copy of the position, sharing only the transposition table.
+  // Every other helper starts a ply deeper, so the threads spread over depths instead of repeating the main search.
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  void searchHelper(SearchContext &owner, Chess<Set, Size, L, T> &chess, int maxDepth, int id)
+  {
+    SearchContext ctx(owner);
+    for (int depth = 1 + (id & 1); depth <= maxDepth && !ctx.aborted(); ++depth)
     {
-      currentCombination.push_back(moveList[depth][i]);
-      generateCombinations(moveList, depth + 1, currentCombination, x, resList);
-      currentCombination.pop_back();
+      ctx.ageHistory();
+      negaMax<Set, Size, L, T, White, true>(ctx, chess, -CHECKMATE, CHECKMATE, depth, 0, std::vector<Chess5D::Move>());
     }
   }
 
-  std::vector<std::vector<Move>> combinations(const std::vector<std::vector<Move>> &moveList, int x)
+  // Fills `result` in from a finished root search
+  inline void takeResult(const SearchContext &ctx, int value, Result &result)
   {
-    std::vector<std::vector<Move>> resList;
-    std::vector<Move> currentCombination;
-    generateCombinations(moveList, 0, currentCombination, x, resList);
-    return resList;
+    const PVLine &line = ctx.pv.lines[0];
+    result.value = value;
+    result.moveset.assign(line.moves, line.moves + (line.plies ? line.sizes[0] : 0));
+    result.pv = line;
   }
 
   template <U8 Set, U8 Size, U16 L, U16 T, bool White>
-  _Compiletime Result negaMaxIDDFS(Chess<Set, Size, L, T> &chess, int maxDepth, std::chrono::milliseconds timeLimit)
+  _Compiletime Result negaMaxIDDFS(SearchContext &ctx, Chess<Set, Size, L, T> &chess, const SearchLimits &limits, int threads = 1, ParallelMode mode = ParallelLazySMP)
   {
-    auto startTime = std::chrono::high_resolution_clock::now();
+    auto startTime = std::chrono::steady_clock::now();
     Result bestRes;
 
-    int alpha = -CHECKMATE;
-    int beta = CHECKMATE;
-    // Perform iterative deepening within the time limit
-    for (int depth = 1; depth <= maxDepth; ++depth)
+    int alpha, beta;
+    ctx.tt.newSearch();
+    ctx.deadline = limits.hardTime == std::chrono::milliseconds::max() ? std::chrono::steady_clock::time_point::max() : startTime + limits.hardTime;
+    ctx.nodeLimit = limits.nodes ? ctx.nodes + limits.nodes : 0;
+
+    // A multiverse spreads its root timelines over the threads, a single timeline runs Lazy SMP helpers or splits nodes
+    const bool multiverse = chess.timelineNum[0] + chess.timelineNum[1] > 0 || chess.origIndex[0] != chess.origIndex[1];
+    const int rootThreads = multiverse ? threads : 1;
+    const int helperCount = multiverse || mode == ParallelYBW ? 0 : threads - 1;
+    const bool ybw = !multiverse && mode == ParallelYBW;
+    const bool pooled = threads > 1 && (multiverse || ybw);
+    Scheduler scheduler;
+    if (pooled)
     {
-      auto elapsedTime = duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime);
+      ctx.scheduler = &scheduler;
+      ctx.splitting = ybw;
+    }
+    if (ybw)
+    {
+      // The root is refreshed as negaMax1 does it, so that the workers' copies start from the owner's position
+      const int timeline = chess.origIndex[0];
+      TimelineInfo &info = chess.timelineInfo[timeline];
+      chess.hash ^= chess.boardKey(timeline, info.turn);
+      chess.boards[timeline][info.turn].template refresh<White>(info);
+      chess.hash ^= chess.boardKey(timeline, info.turn);
+    }
 
-      if (elapsedTime >= timeLimit)
+    // Copies are made before the main search starts changing the position. Lazy SMP helpers search theirs on their own,
+    // scheduler workers keep theirs at the root between tasks, for every iteration and aspiration re-search.
+    std::vector<std::unique_ptr<Chess<Set, Size, L, T>>> copies;
+    std::vector<std::unique_ptr<SearchContext>> workers;
+    std::vector<std::thread> helpers;
+    ctx.stopped = false;
+    for (int i = 0; i < helperCount; ++i)
+      copies.push_back(std::make_unique<Chess<Set, Size, L, T>>(chess));
+    if (pooled)
+    {
+      ctx.workers = {&ctx};
+      ctx.position = &chess;
+      for (int i = 1; i < threads; ++i)
       {
-        std::cout << depth << std::endl;
-        break;
+        copies.push_back(std::make_unique<Chess<Set, Size, L, T>>(chess));
+        workers.push_back(std::make_unique<SearchContext>(ctx));
+        workers.back()->position = copies.back().get();
+        ctx.workers.push_back(workers.back().get());
       }
+      scheduler.start(threads);
+    }
+    for (int i = 1; i <= helperCount; ++i)
+      helpers.emplace_back(searchHelper<Set, Size, L, T, White>, std::ref(ctx), std::ref(*copies[i - 1]), limits.depth, i);
 
-      bestRes = negaMax<Set, Size, L, T, White, true>(chess, alpha, beta, depth, 0, std::vector<Chess5D::Move>());
+    // Perform iterative deepening until a limit is reached, only completed iterations count
+    bool completed = false;
+    for (int depth = 1; depth <= limits.depth && !ctx.stopped; ++depth)
+    {
+      auto elapsedTime = duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
 
-      if (bestRes.value >= CHECKMATE - MAX_PLY)
+      if (elapsedTime >= limits.softTime)
+        break;
+
+      ctx.ageHistory();
+
+      // Aspiration window around the previous iteration's score, widened on whichever side the search fails
+      int delta = ASPIRATION_WINDOW;
+      alpha = -CHECKMATE;
+      beta = CHECKMATE;
+      if (depth > 1 && std::abs(bestRes.value) < CHECKMATE - MAX_PLY)
       {
-        //  alpha=bestRes.value-1;
+        alpha = bestRes.value - delta;
+        beta = bestRes.value + delta;
       }
 
-      if (bestRes.value <= -CHECKMATE + MAX_PLY)
+      while (true)
       {
-        //  beta=bestRes.value+1;
+        int res = negaMax<Set, Size, L, T, White, true>(ctx, chess, alpha, beta, depth, 0, std::vector<Chess5D::Move>(), rootThreads);
+        if (ctx.stopped)
+        {
+          if (!completed) // Better than nothing when even the first iteration ran out of time
+            takeResult(ctx, res, bestRes);
+          break;
+        }
+        delta *= 2;
+        if (res <= alpha && alpha > -CHECKMATE)
+          alpha = std::max(res - delta, -CHECKMATE);
+        else if (res >= beta && beta < CHECKMATE)
+          beta = std::min(res + delta, CHECKMATE);
+        else
+        {
+          takeResult(ctx, res, bestRes);
+          completed = true;
+          break;
+        }
       }
     }
 
+    ctx.stopped = true;
+    for (std::thread &helper : helpers)
+      helper.join();
+    ctx.stopped = false;
+    scheduler.stop();
+    for (const std::unique_ptr<SearchContext> &worker : workers)
+      ctx.addStats(*worker);
+    ctx.workers.clear();
+    ctx.position = nullptr;
+    ctx.scheduler = nullptr;
+    ctx.splitting = false;
+    ctx.deadline = std::chrono::steady_clock::time_point::max();
+    ctx.nodeLimit = 0;
     return bestRes;
   }
 
   template <U8 Set, U8 Size, U16 L, U16 T, bool White, bool PV>
-  _Compiletime Result negaMax(Chess<Set, Size, L, T> &chess, int alpha, int beta, int depth, int ply, std::vector<Chess5D::Move> lastMoves)
+  _Compiletime int negaMax(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int alpha, int beta, int depth, int ply, const std::vector<Chess5D::Move> &lastMoves, int threads = 1)
   {
+    ctx.pv.clear(ply);
+    if (ctx.aborted())
+      return 0;
     if (chess.timelineNum[0] + chess.timelineNum[1] == 0 && chess.origIndex[0] == chess.origIndex[1])
     {
       Move tempNullMove = Move(0, 0, 0, 0, NullMove, 0, 0, 0, 0);
-      int val = negaMax1<Set, Size, L, T, White, true, NodeSpatial>(chess, alpha, beta, depth, 0, chess.origIndex[0], tempNullMove);
-      Result res(val, std::vector<Chess5D::Move>{}, nullptr);
-      return res;
+      return negaMax1<Set, Size, L, T, White, true, NodeSpatial>(ctx, chess, alpha, beta, depth, ply, chess.origIndex[0], tempNullMove);
     }
 
     if (depth <= 0 || ply > MAX_PLY)
     {
-      Result res(0, std::vector<Chess5D::Move>{}, nullptr);
+      int value = 0;
       for (int timeline = chess.origIndex[1] - chess.activeNum[1]; timeline <= chess.origIndex[0] + chess.activeNum[0]; ++timeline)
       {
-        res.value += quiesce<Set, Size, L, T, White, PV>(chess, alpha, beta, 10, ply, timeline, lastMoves[0]);
+        value += quiesce<Set, Size, L, T, White, PV>(ctx, chess, alpha, beta, 10, ply, timeline, lastMoves[0]);
       }
-      return res;
+      return value;
     }
 
-    std::vector<std::vector<Chess5D::Move>> movesAll;
-    int cnt = 0;
+    // Timelines that have a move to make this turn
+    std::vector<int> timelines;
     for (int i = chess.origIndex[1] - chess.activeNum[1]; (i <= chess.origIndex[0] + chess.activeNum[0])&&(chess.timelineInfo[i].turn != chess.present); ++i)
-    {
-      std::vector<Chess5D::Move> moves;
-      chess.template generateMoves<White>(moves, i);
+      timelines.push_back(i);
 
-      // Score
-      for (Move &move : moves)
+    std::vector<TimelineMoves> movesAll(timelines.size());
+    const int workers = std::min<int>(threads, timelines.size());
+    if (workers <= 1 || !ctx.scheduler)
+    {
+      for (int i = 0; i < timelines.size(); ++i)
+        movesAll[i] = searchTimeline<Set, Size, L, T, White>(ctx, chess, alpha, beta, depth, ply, timelines[i]);
+    }
+    else
+    {
+      // The subsearches only meet again in movesAll, so each scheduler worker takes timelines off a shared counter and
+      // searches them on the copy of the multiverse it keeps for the whole search. The calling thread works on the
+      // original, then runs whichever tasks nobody has picked up yet.
+      std::atomic<int> next{0};
+      std::atomic<int> unfinished{workers - 1};
+      auto work = [&](SearchContext &own, Chess<Set, Size, L, T> &position)
       {
-        Move tempNullMove = Move(0, 0, 0, 0, NullMove, 0, 0, 0, 0);
-        moveScore<Set, Size, L, T, White>(chess, depth, i, move, tempNullMove);
-      }
-
-      // Sort
-      std::sort(moves.begin(), moves.end(), [](const Move &a, const Move &b)
-                { return a.score > b.score; });
-
-      // Search
-      for (Move &move : moves)
-      { // could maybe add alpha beta cutoffs at this depth
-        chess.template makeMove<White>(move);
-        int res = negaMax1<Set, Size, L, T, !White, false, NodeSpatial>(chess, -beta, -alpha, depth - 1, ply+1, i, move);
-        chess.template undoMove<White>(move);
-
-        move.score = -res;
-      }
-
-      // Resort
-      std::sort(moves.begin(), moves.end(), [](const Move &a, const Move &b)
-                { return a.score > b.score; });
+        for (int i = next++; i < timelines.size(); i = next++)
+          movesAll[i] = searchTimeline<Set, Size, L, T, White>(own, position, alpha, beta, depth, ply, timelines[i]);
+      };
 
-      movesAll.push_back(moves);
-      cnt++;
+      SearchContext *owner = ctx.owner;
+      for (int i = 1; i < workers; ++i)
+        ctx.scheduler->push(nullptr, [&, owner]
+        {
+          SearchContext &own = *owner->workers[Scheduler::id()];
+          work(own, *static_cast<Chess<Set, Size, L, T> *>(own.position));
+          --unfinished;
+        });
+      work(ctx, chess);
+      while (unfinished > 0)
+        if (!ctx.scheduler->runOne())
+          std::this_thread::yield();
     }
 
-    // naively attempt to play all the best moves of every timeline and only search a handful of those
-    Result bestRes(-CHECKMATE, std::vector<Chess5D::Move>(), nullptr);
-    std::vector<std::vector<Move>> moveList = combinations(movesAll, 3);
-    for (int i = 0; i < moveList.size(); ++i)
+    // Movesets are searched best first, so a cutoff usually comes after the first few
+    int bestRes = -CHECKMATE;
+    MovesetEnumerator movesets(movesAll);
+    std::vector<Move> moves;
+    while (movesets.next(moves))
     {
-      std::vector<Move> moves = moveList[i];
-
       for (Move &move : moves)
       {
         chess.template makeMove<White>(move);
       }
-      Result res = negaMax<Set, Size, L, T, !White, PV>(chess, -beta, -alpha, depth - 1, ply+1, moves);
+      int res = negaMax<Set, Size, L, T, !White, PV>(ctx, chess, -beta, -alpha, depth - 1, ply+1, moves);
       for (Move &move : moves)
       {
         chess.template undoMove<White>(move);
       }
+      if (ctx.aborted())
+        break;
 
-      if (-res.value > bestRes.value)
+      if (-res > bestRes)
+        bestRes = -res;
+      if (bestRes > alpha)
       {
-        bestRes.value = -res.value;
-        bestRes.moveset = moves;
-        bestRes.next = std::make_unique<Result>(res.value, res.moveset, std::move(res.next));
+        alpha = bestRes;
+        ctx.pv.update(ply, moves.data(), moves.size());
       }
-      if (bestRes.value > alpha)
-        alpha = bestRes.value;
 
       if (alpha >= beta)
       {
@@ -392,27 +912,198 @@ namespace Chess5D
     return bestRes;
   };
 
+  // Makes the move, searches the position after it and takes it back, returns the child's value
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White, bool PV, NodeType Node>
+  _Compiletime int searchMove(SearchContext &ctx, Chess<Set, Size, L, T> &chess, const Move &move, int extension, int alpha, int beta, int depth, int ply, int timeline)
+  {
+    int res;
+    const int turn = chess.timelineInfo[timeline].turn;
+    ctx.path[ply] = move;
+    chess.template makeMove<White>(move);
+    extension += checkExtension<Set, Size, L, T, White>(chess, timeline, turn, move);
+    if (move.type >= Travel)
+    {
+      U8 newTimeline = chess.origIndex[White] + (White ? -1 : 1) * (chess.timelineNum[White]);
+      int newDepth = std::min(depth, move.sTurn - move.eTurn) - 1 + extension;
+      res = negaMax1<Set, Size, L, T, !White, PV, NodeTravel>(ctx, chess, -beta, -alpha, newDepth, ply + 1, newTimeline, move);
+    }
+    else
+    {
+      res = negaMax1<Set, Size, L, T, !White, PV, Node>(ctx, chess, -beta, -alpha, depth - 1 + extension, ply + 1, timeline, move);
+    }
+    chess.template undoMove<White>(move);
+    return res;
+  }
+
+  // A negaMax1 node whose younger brothers are searched by several workers
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  struct SearchSplit : SplitPoint
+  {
+    std::vector<Move> path; // The moves leading from the root to the node
+    std::vector<Move> moves;
+    std::vector<int> extensions;
+    std::atomic<int> next{0};    // Index of the next unclaimed brother
+    std::atomic<int> working{0}; // Workers that may still claim or be searching a brother
+    std::atomic<bool> closed{false}; // Set once the owner stops waiting, tasks that still start leave at once
+
+    std::mutex lock; // Guards the window and the best result
+    int alpha;
+    int beta;
+    int bestRes;
+    Move bestMove;
+    bool raised = false; // Whether a brother raised alpha, its line is then in `pv`
+    PVLine pv;
+  };
+
+  // Moves a worker's multiverse down `path` from the node at ply `from` to the one at ply `to`, or back up when `to` is
+  // the smaller. `White` is to move at ply `ply`.
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  void walkPath(Chess<Set, Size, L, T> &chess, const Move *path, int from, int to, int ply)
+  {
+    for (int i = from; i < to; ++i)
+      if ((ply - i) % 2 == 0)
+        chess.template makeMove<White>(path[i]);
+      else
+        chess.template makeMove<!White>(path[i]);
+    for (int i = from - 1; i >= to; --i)
+      if ((ply - i) % 2 == 0)
+        chess.template undoMove<White>(path[i]);
+      else
+        chess.template undoMove<!White>(path[i]);
+  }
+
+  // Claims and searches brothers until none are left, one of them fails high or the search is stopped
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White, NodeType Node>
+  void searchBrothers(SearchContext &ctx, Chess<Set, Size, L, T> &chess, SearchSplit<Set, Size, L, T> &split, int E, int depth, int ply, int timeline)
+  {
+    const SplitPoint *outer = ctx.split;
+    ctx.split = &split;
+    for (int i = split.next++; i < split.moves.size() && !ctx.aborted(); i = split.next++)
+    {
+      int alpha;
+      {
+        std::lock_guard<std::mutex> guard(split.lock);
+        alpha = split.alpha;
+      }
+      const Move &move = split.moves[i];
+      int res = searchMove<Set, Size, L, T, White, false, Node>(ctx, chess, move, E + split.extensions[i], alpha, alpha + 1, depth, ply, timeline);
+      if (-res > alpha && -res < split.beta && !ctx.aborted())
+        res = searchMove<Set, Size, L, T, White, false, Node>(ctx, chess, move, E + split.extensions[i], alpha, split.beta, depth, ply, timeline);
+
+      std::lock_guard<std::mutex> guard(split.lock);
+      if (ctx.aborted()) // The value may be from an abandoned search
+        break;
+      if (-res > split.bestRes)
+      {
+        split.bestRes = -res;
+        split.bestMove = move;
+      }
+      if (split.bestRes > split.alpha)
+      {
+        split.alpha = split.bestRes;
+        split.raised = true;
+        split.pv = ctx.pv.lines[ply + 1];
+      }
+      if (split.alpha >= split.beta)
+        split.cutoff = true;
+    }
+    ctx.split = outer;
+  }
+
+  // Offers the younger brothers to idle workers, searches them alongside and waits for the workers to finish
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White, NodeType Node>
+  void searchSplit(SearchContext &ctx, Chess<Set, Size, L, T> &chess, const std::shared_ptr<SearchSplit<Set, Size, L, T>> &split, int E, int &alpha, int beta, int depth, int ply, int timeline, int &bestRes, Move &bestMove)
+  {
+    split->parent = ctx.split;
+    if (ctx.split)
+      split->ancestors = ctx.split->ancestors;
+    split->ancestors.push_back(split.get());
+    split->alpha = alpha;
+    split->beta = beta;
+    split->bestRes = bestRes;
+    split->bestMove = bestMove;
+    split->path.assign(ctx.path, ctx.path + ply);
+
+    // Tasks refer to the search's owner context, the splitting thread's own may be gone before a stale task runs. The
+    // worker brings its multiverse from where it is waiting, the root when idle, to the node and back, keeping its
+    // ordering tables and counters.
+    SearchContext *owner = ctx.owner;
+    const int helpers = std::min<int>(ctx.scheduler->idle(), split->moves.size() - 1);
+    for (int h = 0; h < helpers; ++h)
+      ctx.scheduler->push(split.get(), [split, owner, E, depth, ply, timeline]
+      {
+        // Counted before looking, so that either the owner waits for this task or the task sees it closed. A closed
+        // split point's parents may be gone.
+        ++split->working;
+        if (split->closed || split->next >= split->moves.size())
+        {
+          --split->working;
+          return;
+        }
+        SearchContext &worker = *owner->workers[Scheduler::id()];
+        Chess<Set, Size, L, T> &own = *static_cast<Chess<Set, Size, L, T> *>(worker.position);
+        const SplitPoint *outer = worker.split;
+        const int height = worker.height;
+        worker.split = split->parent;
+        walkPath<Set, Size, L, T, White>(own, split->path.data(), height, ply, ply);
+        std::copy(split->path.begin() + height, split->path.end(), worker.path + height);
+        searchBrothers<Set, Size, L, T, White, Node>(worker, own, *split, E, depth, ply, timeline);
+        walkPath<Set, Size, L, T, White>(own, split->path.data(), ply, height, ply);
+        worker.split = outer;
+        --split->working;
+      });
+
+    // Once no brother is left to claim, unclaimed tasks are dropped, so no task outlives the split points above it. While
+    // workers are still searching brothers, the thread helps with the nodes they split in turn, which lie below this one
+    // and so share the path to it.
+    searchBrothers<Set, Size, L, T, White, Node>(ctx, chess, *split, E, depth, ply, timeline);
+    split->closed = true;
+    ctx.scheduler->discard(split.get());
+    const int height = ctx.height;
+    ctx.height = ply;
+    while (split->working > 0)
+      if (!ctx.scheduler->runOne(split.get()))
+        std::this_thread::yield();
+    ctx.height = height;
+
+    std::lock_guard<std::mutex> guard(split->lock);
+    alpha = split->alpha;
+    bestRes = split->bestRes;
+    bestMove = split->bestMove;
+    if (split->raised)
+      ctx.pv.lines[ply].set(&bestMove, 1, split->pv);
+  }
+
   //Should result be int or double?
   template <U8 Set, U8 Size, U16 L, U16 T, bool White, bool PV, NodeType Node>
-  _Compiletime int negaMax1(Chess<Set, Size, L, T> &chess, int alpha, int beta, int depth, int ply, int timeline, Move lastMove)
+  _Compiletime int negaMax1(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int alpha, int beta, int depth, int ply, int timeline, Move lastMove)
   {
+    ctx.pv.clear(ply);
+    if (ctx.aborted())
+      return 0;
+    if ((++ctx.nodes & (POLL_NODES - 1)) == 0)
+      ctx.poll();
     int alphaOrig = alpha;
     TimelineInfo &info = chess.timelineInfo[timeline];
     Board<Set> &brd = chess.boards[timeline][info.turn];
 
     if (PV && ply == 0)
-      brd.template refresh<White>(info); // TODO: Add to actual function
+    { // TODO: Add to actual function
+      chess.hash ^= chess.boardKey(timeline, info.turn); // refresh may drop the en passant target, which is in the key
+      brd.template refresh<White>(info);
+      chess.hash ^= chess.boardKey(timeline, info.turn);
+    }
 
-    // Transposition Table Lookup
-    U64 key = tt.computeHashKey<Set, White>(brd);
-    TTEntry &ttEntry = tt.probe(key);
-    if (ttEntry.key == key && ttEntry.depth >= depth && !ttEntry.isQSearch)
+    // Transposition Table Lookup, the root is always searched so that it has a principal variation
+    U64 key = ctx.tt.computeHashKey<White>(chess, timeline);
+    TTEntry ttEntry = ctx.tt.probe(key);
+    if (ply > 0 && ttEntry.key == key && ttEntry.depth >= depth && !ttEntry.isQSearch)
     {
       if (ttEntry.isWhite != White)
       {
-        collision++;
+        ctx.collision++;
       }
-      hitCount++;
+      ctx.hitCount++;
       if (ttEntry.flag == TTEntry::EXACT)
       {
         return ttEntry.value;
@@ -456,11 +1147,10 @@ namespace Chess5D
     // Quiescence Search
     if (depth <= 0 || ply > MAX_PLY)
     {
-      return quiesce<Set, Size, L, T, White, PV>(chess, alpha, beta, -1, ply, timeline, lastMove);
+      return quiesce<Set, Size, L, T, White, PV>(ctx, chess, alpha, beta, -1, ply, timeline, lastMove);
     }
 
-    std::vector<Move> moves;
-    moves.reserve(100);
+    MoveList<> moves;
     chess.template generateMoves<White>(moves, timeline);
 
     int E = 0; // Extension Value
@@ -475,63 +1165,50 @@ namespace Chess5D
 
     bool inCheck = brd.pastCheck != EMPTY && brd.checkMask == FULL;
 
-    bool PVMove = false;
     // Move Ordering
-    for (auto it = moves.begin(); it != moves.end(); ++it)
-    {
-      if (PV && *it == ttEntry.move)
-      {
-        PVMove = true;
-        std::rotate(moves.begin(), it, moves.end());
-        continue;
-      }
-      moveScore<Set, Size, L, T, White>(chess, depth, timeline, *it, lastMove);
-    }
-
-    std::sort(moves.begin() + (int)PVMove, moves.end(), [](const Move &a, const Move &b)
-              { return a.score > b.score; });
+    Move &counter = counterSlot(ctx, brd, lastMove);
+    MovePicker<Set, Size, L, T, White> picker(chess, moves, timeline, ttEntry.key == key ? &ttEntry.move : nullptr, ctx, ply, counter);
 
     int bestRes = -CHECKMATE+ply;
-    Move bestMove=moves[0];
+    Move bestMove;
     int res;
-    
-    for (int i = 0; i < moves.size(); ++i)
+    std::shared_ptr<SearchSplit<Set, Size, L, T>> split;
+
+    Move move;
+    int moveE;
+    for (int i = 0; picker.next(move, moveE); ++i)
     {
-      Move move = moves[i];
+      if (i == 0)
+        bestMove = move;
 
       if (Node == NodeTravel && move.type >= Travel)
         continue;
 
       if (depth >= 3 && !inCheck)
-        move.E -= int(log(i + 2));
+        moveE -= int(log(i + 2));
 
-      chess.template makeMove<White>(move);
-      if (move.type >= Travel)
+      // Young Brothers Wait: once the eldest brother is searched, the younger ones are shared with idle workers
+      if (i > 0 && !split && ctx.splitting && depth >= MIN_SPLIT_DEPTH && ctx.scheduler->idle() > 0)
+        split = std::make_shared<SearchSplit<Set, Size, L, T>>();
+      if (split)
       {
-        U8 newTimeline = chess.origIndex[White] + (White ? -1 : 1) * (chess.timelineNum[White]);
-        int newDepth = std::min(depth, move.sTurn - move.eTurn) - 1 + E + move.E;
-        if (PV && i == 0)
-        {
-          res = negaMax1<Set, Size, L, T, !White, true, NodeTravel>(chess, -beta, -alpha, newDepth, ply + 1, newTimeline, move);
-        }
-        else
-        {
-          res = negaMax1<Set, Size, L, T, !White, false, NodeTravel>(chess, -beta, -alpha, newDepth, ply + 1, newTimeline, move);
-        }
+        split->moves.push_back(move);
+        split->extensions.push_back(moveE);
+        continue;
       }
+
+      // Principal variation search: the first move gets the full window, the others a null window scout that is only
+      // searched again when it lands inside the window
+      if (i == 0)
+        res = searchMove<Set, Size, L, T, White, PV, Node>(ctx, chess, move, E + moveE, alpha, beta, depth, ply, timeline);
       else
       {
-        int newDepth = depth - 1 + E + move.E;
-        if (PV && i == 0)
-        {
-          res = negaMax1<Set, Size, L, T, !White, true, Node>(chess, -beta, -alpha, newDepth, ply + 1, timeline, move);
-        }
-        else
-        {
-          res = negaMax1<Set, Size, L, T, !White, false, Node>(chess, -beta, -alpha, newDepth, ply + 1, timeline, move);
-        }
+        res = searchMove<Set, Size, L, T, White, false, Node>(ctx, chess, move, E + moveE, alpha, alpha + 1, depth, ply, timeline);
+        if (-res > alpha && -res < beta && !ctx.aborted())
+          res = searchMove<Set, Size, L, T, White, PV, Node>(ctx, chess, move, E + moveE, alpha, beta, depth, ply, timeline);
       }
-      chess.template undoMove<White>(move);
+      if (ctx.aborted()) // The value stands in for a search that was cut short
+        break;
 
       if (-res > bestRes)
       {
@@ -539,16 +1216,23 @@ namespace Chess5D
         bestMove = move;
       }
       if (bestRes > alpha)
+      {
         alpha = bestRes;
+        ctx.pv.update(ply, &move, 1);
+      }
 
       if (alpha >= beta)
-      {
-        killerTable.addElement(move);
         break;
-      }
     }
 
-    // Transposition Table Store
+    if (split)
+      searchSplit<Set, Size, L, T, White, Node>(ctx, chess, split, E, alpha, beta, depth, ply, timeline, bestRes, bestMove);
+    if (alpha >= beta && isQuiet(bestMove) && !ctx.aborted())
+      ctx.rewardQuiet(bestMove, brd.board.mailboxBoard[bestMove.from], ply, depth, counter);
+
+    // Transposition Table Store, unless the result was cut short
+    if (ctx.aborted())
+      return bestRes;
     ttEntry.move = bestMove;
     ttEntry.value = bestRes;
     ttEntry.key = key;
@@ -567,28 +1251,33 @@ namespace Chess5D
       ttEntry.flag = TTEntry::EXACT;
     }
     ttEntry.depth = depth;
-    tt.store(ttEntry);
+    ctx.tt.store(ttEntry);
 
     return bestRes;
   };
 
   template <U8 Set, U8 Size, U16 L, U16 T, bool White, bool PV>
-  _Compiletime int quiesce(Chess<Set, Size, L, T> &chess, int alpha, int beta, int depth, int ply, int timeline, Move lastMove)
+  _Compiletime int quiesce(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int alpha, int beta, int depth, int ply, int timeline, Move lastMove)
   {
+    ctx.pv.clear(ply); // Quiescence lines are not collected
+    if (ctx.aborted())
+      return 0;
+    if ((++ctx.nodes & (POLL_NODES - 1)) == 0)
+      ctx.poll();
     int alphaOrig = alpha;
     TimelineInfo info = chess.timelineInfo[timeline];
     Board<Set> &brd = chess.boards[timeline][info.turn];
 
     // Transposition Table Lookup
-    U64 key = tt.computeHashKey<Set, White>(brd);
-    TTEntry &ttEntry = tt.probe(key);
+    U64 key = ctx.tt.computeHashKey<White>(chess, timeline);
+    TTEntry ttEntry = ctx.tt.probe(key);
     if (ttEntry.key == key && ttEntry.depth >= depth)
     {
       if (ttEntry.isWhite != White)
       {
-        collision++;
+        ctx.collision++;
       }
-      hitCount++;
+      ctx.hitCount++;
       if (ttEntry.flag == TTEntry::EXACT)
       {
         return ttEntry.value;
@@ -625,7 +1314,7 @@ namespace Chess5D
         return mating_value;
     }
 
-    int val = evaluate<Set, Size, L, T, White>(chess, timeline, ply);
+    int val = evaluate<Set, Size, L, T, White>(ctx, chess, timeline, ply);
     if (depth <= 0 || ply > MAX_PLY)
     {
       return val;
@@ -639,80 +1328,68 @@ namespace Chess5D
       alpha = val;
     }
 
-    std::vector<Move> moves;
-    moves.reserve(100);
-    chess.template generateMoves<White>(moves, timeline); // should generate only captures/checks efficiently
+    chess.template updatePastCheck<White>(timeline); // Past checks decide which moves get generated
 
-    // Remove Travels completely
-    moves.erase(std::remove_if(moves.begin(), moves.end(), [&](Move &move) { return move.type >= Travel; }),moves.end());
+    // Travels are never searched here
+    MoveList<> moves;
+    const bool evading = brd.checkMask != FULL || brd.pastCheck != EMPTY;
 
     int E = 0; // Extension Value
-    if (moves.size() < 2)
+    if (evading)
     {
-      if (moves.size() == 0)
+      chess.template generateMoves<White, GenSpatial>(moves, timeline);
+      if (moves.size() < 2)
       {
-        return -CHECKMATE + ply;
+        if (moves.size() == 0)
+        {
+          return -CHECKMATE + ply;
+        }
+        E += 1; // Only Reply
       }
-      E += 1; // Only Reply
     }
-
-    std::vector<Move> quietMoves;
-    quietMoves.reserve(50);
-
-    // Remove Quiet Moves and only search for mate check
-    if (brd.checkMask == FULL && brd.pastCheck == EMPTY)
+    else
     {
-      std::partition_copy(moves.begin(), moves.end(), std::back_inserter(quietMoves), std::back_inserter(moves), [&](Move &move){
-            if (move.type == Capture || move.type == PromoCapture) {
-                return true;
-            }
-
-            chess.template makeMove<White>(move);
-            Board<Set>& newBrd = chess.boards[timeline][info.turn + 1];
-            createMask<Set, T, !White>(&newBrd);
-
-            bool checkCaused = (newBrd.pastCheck != EMPTY || newBrd.checkMask != FULL);
-            chess.template undoMove<White>(move);
+      // Captures and the check candidates, of which only the moves really giving a check (also through time) are kept
+      chess.template generateMoves<White, GenCaptures>(moves, timeline);
+      U16 kept = moves.size();
+      const CheckInfo checkInfo = chess.template checkInfo<White>(timeline);
+      chess.template generateMoves<White, GenQuietChecks>(moves, timeline, checkInfo.time);
 
-            return checkCaused;});
+      for (U16 i = kept; i < moves.size(); ++i)
+      {
+        if (chess.template givesCheck<White>(moves[i], checkInfo))
+          moves[kept++] = moves[i];
+      }
+      moves.resize(kept);
     }
 
     bool inCheck = brd.pastCheck != EMPTY && brd.checkMask == FULL;
 
-    bool PVMove = false;
     // Move Ordering
-    for (auto it = moves.begin(); it != moves.end(); ++it)
-    {
-      if (PV && *it == ttEntry.move)
-      {
-        PVMove = true;
-        std::rotate(moves.begin(), it, moves.end());
-        continue;
-      }
-      moveScore<Set, Size, L, T, White>(chess, depth, timeline, *it, lastMove);
-    }
+    Move &counter = counterSlot(ctx, brd, lastMove);
+    MovePicker<Set, Size, L, T, White> picker(chess, moves, timeline, ttEntry.key == key ? &ttEntry.move : nullptr, ctx, ply, counter);
 
-    std::sort(moves.begin() + (int)PVMove, moves.end(), [](const Move &a, const Move &b)
-              { return a.score > b.score; });
-    
     int bestRes = -CHECKMATE + ply;
     int res;
     Move bestMove;
-    if(moves.size()!=0) bestMove=moves[0];
-    for (int i = 0; i < moves.size(); ++i)
+    Move move;
+    int moveE;
+    for (int i = 0; picker.next(move, moveE); ++i)
     {
-      Move move = moves[i];
+      if (i == 0)
+        bestMove = move;
 
       if (depth >= 3 && !inCheck)
-        move.E -= int(log(i + 2)); // LMR
+        moveE -= int(log(i + 2)); // LMR
 
       chess.template makeMove<White>(move);
+      moveE += checkExtension<Set, Size, L, T, White>(chess, timeline, info.turn, move);
       if (PV && i == 0)
       {
-        res = quiesce<Set, Size, L, T, !White, true>(chess, -beta, -alpha, depth - 1 + E + move.E, ply + 1, timeline, move);
+        res = quiesce<Set, Size, L, T, !White, true>(ctx, chess, -beta, -alpha, depth - 1 + E + moveE, ply + 1, timeline, move);
       }
       else{
-        res = quiesce<Set, Size, L, T, !White, false>(chess, -beta, -alpha, depth - 1 + E + move.E, ply + 1, timeline, move);
+        res = quiesce<Set, Size, L, T, !White, false>(ctx, chess, -beta, -alpha, depth - 1 + E + moveE, ply + 1, timeline, move);
       }
       chess.template undoMove<White>(move);
 
@@ -726,24 +1403,32 @@ namespace Chess5D
 
       if (alpha >= beta)
       {
-        killerTable.addElement(move);
+        if (isQuiet(move))
+          ctx.rewardQuiet(move, brd.board.mailboxBoard[move.from], ply, depth, counter);
         break;
       }
     }
-    if (bestRes <= -CHECKMATE + MAX_PLY && quietMoves.size()!=0)
+    // Only search for mate when nothing tactical holds
+    if (!evading && bestRes <= -CHECKMATE + MAX_PLY)
     {
-      for (Move &move : quietMoves) moveScore<Set, Size, L, T, White>(chess, depth, timeline, move, lastMove);
-      std::sort(quietMoves.begin(), quietMoves.end(), [](const Move &a, const Move &b){return a.score > b.score;});
+      // Every spatial move is generated behind the searched ones, which are then dropped, so the frame holds one list
+      const U16 searched = moves.size();
+      chess.template generateMoves<White, GenSpatial>(moves, timeline);
+      Move *const quiets = moves.begin() + searched;
+      moves.resize(std::remove_if(quiets, moves.end(), [&](const Move &quiet)
+                                  { return std::find(moves.begin(), quiets, quiet) != quiets; }) - moves.begin());
+      moves.erase(moves.begin(), quiets);
 
-      for (int i = 0; i < quietMoves.size(); ++i)
-      {
-        Move move = quietMoves[i];
+      MovePicker<Set, Size, L, T, White> quietPicker(chess, moves, timeline, nullptr, ctx, ply, counter);
 
+      for (int i = 0; quietPicker.next(move, moveE); ++i)
+      {
         if (depth >= 3 && !inCheck)
-          move.E -= int(log(i + 2)); // LMR
+          moveE -= int(log(i + 2)); // LMR
 
         chess.template makeMove<White>(move);
-        res = quiesce<Set, Size, L, T, !White, false>(chess, -beta, -alpha, depth - 1 + E + move.E, ply + 1, timeline, move);
+        moveE += checkExtension<Set, Size, L, T, White>(chess, timeline, info.turn, move);
+        res = quiesce<Set, Size, L, T, !White, false>(ctx, chess, -beta, -alpha, depth - 1 + E + moveE, ply + 1, timeline, move);
         chess.template undoMove<White>(move);
 
         if (-res > bestRes)
@@ -755,7 +1440,9 @@ namespace Chess5D
       }
     }
 
-    // Transposition Table Store
+    // Transposition Table Store, unless the result was cut short
+    if (ctx.aborted())
+      return bestRes;
     ttEntry.move = bestMove;
     ttEntry.value = bestRes;
     ttEntry.key = key;
@@ -774,40 +1461,36 @@ namespace Chess5D
       ttEntry.flag = TTEntry::EXACT;
     }
     ttEntry.depth = depth;
-    tt.store(ttEntry);
+    ctx.tt.store(ttEntry);
 
     return bestRes;
   };
 
   template <U8 Set, U8 Size, U16 L, U16 T, bool White>
-  _Compiletime Result negaMax_Test(Chess<Set, Size, L, T> &chess, int depth, int timeline)
+  _Compiletime Result negaMax_Test(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int depth, int timeline)
   {
     if (depth == 0)
     {
-      Result res = Result(evaluate<Set, Size, L, T, White>(chess, timeline, depth), Move(0, 0, 0, 0, NullMove, 0, 0, 0, 0), nullptr);
-
-      return res;
+      return Result{evaluate<Set, Size, L, T, White>(ctx, chess, timeline, depth)};
     }
 
-    std::vector<Move> moves;
-    moves.reserve(100);
+    MoveList<> moves;
     chess.template generateMoves<White>(moves, timeline);
 
-    Result bestRes = Result(-CHECKMATE, Move(0, 0, 0, 0, NullMove, 0, 0, 0, 0), nullptr);
+    Result bestRes{-CHECKMATE};
 
     for (int i = 0; i < moves.size(); ++i)
     {
       Move move = moves[i];
 
       chess.template makeMove<White>(move);
-      Result res = negaMax_Test<Set, Size, L, T, !White>(chess, depth - 1, timeline);
+      Result res = negaMax_Test<Set, Size, L, T, !White>(ctx, chess, depth - 1, timeline);
       chess.template undoMove<White>(move);
 
       if (-res.value > bestRes.value)
       {
         bestRes.value = -res.value;
-        bestRes.moveset = move;
-        bestRes.next = std::make_unique<Result>(res.value, res.moveset, std::move(res.next));
+        bestRes.moveset = {move};
       }
     }
 
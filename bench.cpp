@@ -0,0 +1,141 @@
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include <string>
+#include "ai.hpp"
+#include "perft.hpp"
+#include "positions.hpp"
+
+using namespace Chess5D;
+
+// Single timeline positions, searched with negaMax1 so move ordering changes show up directly in the node count
+static constexpr int BENCH_POSITIONS[] = {0, 1, 2, 3};
+static constexpr int NUM_POSITIONS = 12;
+static constexpr int MOVEGEN_REPS = 20000;
+static constexpr int TT_OPS = 4000000;
+
+template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+int search(SearchContext &ctx, Chess<Set, Size, L, T> &chess, int depth, int threads, ParallelMode mode, bool iterate)
+{
+    // Time to depth of the parallel search. Nodes are those of the main thread, and of the workers with YBW.
+    if (iterate)
+        return negaMaxIDDFS<Set, Size, L, T, White>(ctx, chess, SearchLimits{depth}, threads, mode).value;
+    const Move nullMove = Move(0, 0, 0, 0, NullMove, 0, 0, 0, 0);
+    return negaMax1<Set, Size, L, T, White, true, NodeSpatial>(ctx, chess, -CHECKMATE, CHECKMATE, depth, 0, chess.origIndex[0], nullMove);
+}
+
+// Generates the moves of the first playable timeline `reps` times, returns the time taken
+template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+double timeGenerateMoves(Chess<Set, Size, L, T> &chess, int reps, U64 &generated)
+{
+    const int timeline = chess.template playableTimeline<White>();
+    MoveList<> moves;
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < reps; ++i)
+    {
+        moves.clear();
+        chess.template generateMoves<White>(moves, timeline);
+        generated += moves.size();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1000000000.0;
+}
+
+// Stores and then probes pseudo-random keys, returns the seconds taken by each half
+std::pair<double, double> timeTranspositionTable(int ops, U64 &hits)
+{
+    std::mt19937_64 rng(1);
+    std::vector<U64> keys(ops);
+    for (U64 &key : keys)
+        key = rng();
+
+    tt.clear();
+    TTEntry entry;
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ops; ++i)
+    {
+        entry.key = keys[i];
+        entry.depth = i & 15;
+        entry.value = i;
+        tt.store(entry);
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ops; ++i)
+        hits += tt.probe(keys[i]).key == keys[i];
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return {std::chrono::duration_cast<std::chrono::nanoseconds>(middle - begin).count() / 1000000000.0,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count() / 1000000000.0};
+}
+
+// Usage: bench [depth] [threads] [lazysmp|ybw]
+// Naming a mode runs negaMaxIDDFS even on one thread, so that every point of a scaling curve times the same search.
+// Built with `make bench traffic`, it also reports the board bytes a generateMoves call copies or reads.
+int main(int argc, char **argv)
+{
+    constexpr U8 Set = Chess5D::NoPiece;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    const int depth = argc > 1 ? std::stoi(argv[1]) : 4;
+    const int threads = argc > 2 ? std::stoi(argv[2]) : 1;
+    const ParallelMode mode = argc > 3 && std::string(argv[3]) == "ybw" ? ParallelYBW : ParallelLazySMP;
+    const bool iterate = threads > 1 || argc > 3;
+
+    U64 totalNodes = 0;
+    double totalTime = 0;
+    for (const int pos : BENCH_POSITIONS)
+    {
+        // Too large for the default stack
+        auto chess = std::make_unique<Chess<Set, Size, L, T>>();
+        Positions::load(*chess, pos);
+        tt.clear();
+        evalCache.clear();
+        SearchContext ctx(tt);
+
+        auto begin = std::chrono::high_resolution_clock::now();
+        const int value = whiteToMove(*chess) ? search<Set, Size, L, T, true>(ctx, *chess, depth, threads, mode, iterate) : search<Set, Size, L, T, false>(ctx, *chess, depth, threads, mode, iterate);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        const double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1000000000.0;
+        totalNodes += ctx.nodes;
+        totalTime += seconds;
+
+        std::cout << "Position " << pos << " depth " << depth << ": value " << value << ", " << ctx.nodes << " nodes, "
+                  << ctx.count << " evals, " << ctx.evalHits << " cached, " << seconds << " s" << std::endl;
+    }
+
+    std::cout << "Total: " << totalNodes << " nodes, " << totalTime << " s, "
+              << U64(totalNodes / std::max(totalTime, 1e-9)) << " nodes/s" << std::endl;
+
+    // Move generation alone, over every position so the travel paths are exercised too
+    U64 generated = 0;
+    double genTime = 0;
+#ifdef GEN_TRAFFIC
+    genTraffic = {};
+#endif
+    for (int pos = 0; pos < NUM_POSITIONS; ++pos)
+    {
+        auto chess = std::make_unique<Chess<Set, Size, L, T>>();
+        Positions::load(*chess, pos);
+        genTime += whiteToMove(*chess) ? timeGenerateMoves<Set, Size, L, T, true>(*chess, MOVEGEN_REPS, generated)
+                                       : timeGenerateMoves<Set, Size, L, T, false>(*chess, MOVEGEN_REPS, generated);
+    }
+    std::cout << "generateMoves: " << genTime * 1000000000.0 / (NUM_POSITIONS * MOVEGEN_REPS) << " ns/call, "
+              << generated / (NUM_POSITIONS * MOVEGEN_REPS) << " moves/call, Board is " << sizeof(Board<Set>) << " bytes" << std::endl;
+#ifdef GEN_TRAFFIC
+    // Copying every board read whole, as generation used to, against the fields it gathers now
+    std::cout << "Board traffic: " << double(genTraffic.boards) / (NUM_POSITIONS * MOVEGEN_REPS) << " boards/call, "
+              << genTraffic.boards * sizeof(Board<Set>) / (NUM_POSITIONS * MOVEGEN_REPS) << " bytes/call by value, "
+              << genTraffic.bytes / (NUM_POSITIONS * MOVEGEN_REPS) << " bytes/call by reference" << std::endl;
+#endif
+
+    U64 hits = 0;
+    const auto [storeTime, probeTime] = timeTranspositionTable(TT_OPS, hits);
+    std::cout << "Transposition table: " << U64(TT_OPS / storeTime) << " stores/s, " << U64(TT_OPS / probeTime) << " probes/s, "
+              << 100.0 * hits / TT_OPS << "% found" << std::endl;
+    return 0;
+}
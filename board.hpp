@@ -2,46 +2,239 @@
 
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <random>
 #include "lookup.hpp"
+#include "nnue.hpp"
 
 namespace Chess5D
 {
+  // Packed into 64 bits: squares, specials and type take the first 32, the timeline/turn indices the rest.
+  // U16 bit-fields still promote to int, so square arithmetic keeps its sign. Ordering scores and
+  // extensions live next to the moves in MoveList instead.
   struct Move
   {
-    U8 from = 0;
-    U8 to = 0;
-    U8 special1 = 0;
-    U8 special2 = 0;
+    U16 from : 6 = 0;
+    U16 to : 6 = 0;
+    U16 type : 4 = 0;
+    U16 special1 : 6 = 0; // Promotion piece, castling rook square or en passant capture square
+    U16 special2 : 6 = 0; // Castling rook destination
+    U16 unused : 4 = 0;   // Kept zero so that encode() is well defined
 
     U8 sTimeline = 0;
     U8 sTurn = 0;
     U8 eTimeline = 0;
     U8 eTurn = 0;
 
-    U8 type = 0;
-    int score = 0;
-    int E = 0;
-
     constexpr Move() {}
 
-    constexpr Move(const U8 f, const U8 t, const U8 s1, const U8 s2, const U8 tp, const U8 sl, const U8 st, const U8 el, const U8 et) : from(f), to(t), special1(s1), special2(s2), type(tp), sTimeline(sl), sTurn(st), eTimeline(el), eTurn(et)
+    constexpr Move(const U8 f, const U8 t, const U8 s1, const U8 s2, const U8 tp, const U8 sl, const U8 st, const U8 el, const U8 et) : from(f), to(t), type(tp), special1(s1), special2(s2), sTimeline(sl), sTurn(st), eTimeline(el), eTurn(et)
     {
     }
 
+    _Compiletime U64 encode() const { return std::bit_cast<U64>(*this); }
+    static _Compiletime Move decode(const U64 data) { return std::bit_cast<Move>(data); }
+
     // Equality operator overloading
     constexpr bool operator==(const Move &other) const
     {
-      return (from == other.from) &&
-             (to == other.to) &&
-             (special1 == other.special1) &&
-             (special2 == other.special2) &&
-             (sTimeline == other.sTimeline) &&
-             (sTurn == other.sTurn) &&
-             (eTimeline == other.eTimeline) &&
-             (eTurn == other.eTurn) &&
-             (type == other.type);
+      return encode() == other.encode();
+    }
+  };
+  static_assert(sizeof(Move) == sizeof(U64));
+  static_assert(TravelPromoCapture < 1 << 4); // Move::type
+  static_assert(NoPiece < 1 << 6);            // Move::special1 as a promotion piece
+
+  static constexpr U16 MAX_MOVES = 1024;
+
+  // Fixed-capacity move buffer that lives on the stack, so generating moves never touches the heap. A full list takes
+  // 16 KB of stack, so a search frame keeps one at most.
+  template <U16 Capacity = MAX_MOVES>
+  struct MoveList
+  {
+    using value_type = Move;
+
+    union
+    {
+      Move moves[Capacity]; // Left uninitialised, only the first `count` moves are valid
+    };
+    int scores[Capacity];     // Ordering score of moves[i], filled in by the search
+    int extensions[Capacity]; // Depth extension of moves[i], filled in by the search
+    U16 count = 0;
+
+    MoveList() {}
+
+    template <typename... Args>
+    _Compiletime void emplace_back(const Args... args)
+    {
+      assert(count < Capacity);
+      moves[count++] = Move(args...);
+    }
+
+    _Compiletime void push_back(const Move &move)
+    {
+      assert(count < Capacity);
+      moves[count++] = move;
+    }
+    _Compiletime void pop_back() { --count; }
+    _Compiletime void clear() { count = 0; }
+    _Compiletime void resize(const U16 size) { count = size; }
+
+    _Compiletime void erase(Move *first, Move *last)
+    {
+      const U16 i = first - moves, j = last - moves;
+      std::copy(last, end(), first);
+      std::copy(scores + j, scores + count, scores + i);
+      std::copy(extensions + j, extensions + count, extensions + i);
+      count -= j - i;
+    }
+
+    // Insertion sort by descending score from index `first` on, moves and extensions follow their scores.
+    _Compiletime void sortByScore(const U16 first = 0)
+    {
+      for (U16 i = first + 1; i < count; ++i)
+      {
+        const Move move = moves[i];
+        const int score = scores[i], extension = extensions[i];
+        U16 j = i;
+        for (; j > first && scores[j - 1] < score; --j)
+        {
+          moves[j] = moves[j - 1];
+          scores[j] = scores[j - 1];
+          extensions[j] = extensions[j - 1];
+        }
+        moves[j] = move;
+        scores[j] = score;
+        extensions[j] = extension;
+      }
+    }
+
+    _Compiletime U16 size() const { return count; }
+    _Compiletime bool empty() const { return count == 0; }
+
+    _Compiletime Move *begin() { return moves; }
+    _Compiletime Move *end() { return moves + count; }
+    _Compiletime const Move *begin() const { return moves; }
+    _Compiletime const Move *end() const { return moves + count; }
+
+    _Compiletime Move &operator[](const U16 i) { return moves[i]; }
+    _Compiletime const Move &operator[](const U16 i) const { return moves[i]; }
+  };
+
+  // Which moves generateMoves produces. Only GenAll produces travels, unicorn and dragon moves included as they never stay
+  // on the board, the other modes never build travel masks.
+  enum GenMode : U8
+  {
+    GenAll,        // Every legal move
+    GenCaptures,   // Captures, en passant and capture promotions
+    GenSpatial,    // Every move that stays on the board, as in check where the legal mask already restricts them
+    GenQuietChecks // Quiet moves that may check on the same board, directly or by uncovering a slider, or through time, plus quiet promotions
+  };
+
+  // Zobrist keys shared by every board. They come from a fixed seed, so keys and table snapshots carry over between runs.
+  struct Zobrist
+  {
+    U64 seed; // Recorded in table snapshots
+    U64 piece[64][NoPiece];
+    U64 color[2];
+    U64 ep[8];
+    U64 unmoved[64];
+    U64 timeline[256]; // Board coordinates in the multiverse hash
+    U64 turn[256];
+
+    Zobrist(const U64 seed) : seed(seed)
+    {
+      std::mt19937_64 rng(seed);
+      for (int sq = 0; sq < 64; ++sq)
+      {
+        for (int p = 0; p < NoPiece; ++p)
+          piece[sq][p] = rng();
+        unmoved[sq] = rng();
+      }
+      color[0] = rng();
+      color[1] = rng();
+      for (int file = 0; file < 8; ++file)
+        ep[file] = rng();
+      for (int i = 0; i < 256; ++i)
+      {
+        timeline[i] = rng();
+        turn[i] = rng();
+      }
+    }
+
+    // Places a board key at its coordinates. Mixed rather than XORed, so that swapping two boards changes the result.
+    static _Compiletime U64 place(U64 key, const U64 coordinates)
+    {
+      key += coordinates;
+      key = (key ^ key >> 30) * 0xbf58476d1ce4e5b9ull;
+      key = (key ^ key >> 27) * 0x94d049bb133111ebull;
+      return key ^ key >> 31;
+    }
+  };
+  inline Zobrist zobrist(0x5D5D5D5D5D5D5D5Dull);
+
+  // Material value of each piece type, for the evaluation and move ordering
+  inline int typeToVal[NoType] = {1, 5, 5, 3, 15, 0, 9, 4, 0, 3, 2, .25};
+
+  static constexpr bool PIECE_SQUARES = false; // Whether boards also sum pawn advancement and centred pieces for evaluate
+
+  // What every piece adds to the sums of its board, White's positive and Black's negative
+  struct PieceValues
+  {
+    int material[NoPiece + 1]{};
+    int square[64][NoPiece + 1]{};
+
+    PieceValues()
+    {
+      for (int type = 0; type < NoType; ++type)
+        for (int white = 0; white < 2; ++white)
+        {
+          const Piece piece = toPiece(white, PieceType(type));
+          const int sign = white ? 1 : -1;
+          material[piece] = sign * typeToVal[type];
+          for (int sq = 0; sq < 64; ++sq)
+          {
+            const int file = sq % 8;
+            const int rank = white ? sq / 8 : 7 - sq / 8;
+            const int centre = 3 - std::max(std::abs(2 * file - 7), std::abs(2 * rank - 7)) / 2; // 0 on the rim, 3 in the middle
+            const bool royal = type == King || type == CKing || type == RQueen;
+            const int value = type == Pawn || type == Brawn ? rank - 1 // Advancement
+                              : royal                      ? 0
+                                                           : centre;
+            square[sq][piece] = sign * value;
+          }
+        }
     }
   };
+  inline PieceValues pieceValues;
+
+  // Running sums over the pieces of a board for the evaluation, White's counting positive and Black's negative
+  struct Accumulator
+  {
+    int material = 0;
+    int psq = 0; // Only summed with PIECE_SQUARES
+    int castling = 0; // Unmoved pieces of types 3 and 5, the castle ability evaluate scores
+
+    _Compiletime Accumulator &operator+=(const Accumulator &other)
+    {
+      material += other.material;
+      psq += other.psq;
+      castling += other.castling;
+      return *this;
+    }
+
+    _Compiletime Accumulator &operator-=(const Accumulator &other)
+    {
+      material -= other.material;
+      psq -= other.psq;
+      castling -= other.castling;
+      return *this;
+    }
+
+    bool operator==(const Accumulator &other) const = default;
+  };
 
   struct TimelineInfo
   {
@@ -68,6 +261,11 @@ namespace Chess5D
       U64 black{EMPTY};
       U64 unmoved{EMPTY};
       U64 epTarget{EMPTY};
+      U64 hash{0}; // Zobrist key of the pieces and castling rights, kept up to date by the move functions
+      Accumulator sums; // Kept up to date the same way
+#ifdef NNUE
+      HiddenLayer hidden; // First layer of the network over the pieces, kept up to date the same way
+#endif
     } board; // TODO: rename/reorganize so that there isnt a board within board.
 
     struct
@@ -100,10 +298,19 @@ namespace Chess5D
     _Compiletime U64 dragons(const bool White, const bool Royal) const;
     _Compiletime U64 royalty(const bool White) const;
 
-    template <U8 Size, bool White, bool Check>
-    _Compiletime void genPawnMoves(std::vector<Move> &moves, const TimelineInfo &info, const U64 legalMask, const U64 notPin, const U64 notPinHV, const U64 notPinD12, const TMask &tMask) const;
+    _Compiletime U64 squaresKey(U64 squares) const;
+    _Compiletime U64 epKey() const;
+    _Compiletime U64 fullHash() const;
+    _Compiletime Accumulator squaresSum(U64 squares) const;
+    _Compiletime Accumulator fullSum() const;
+    template <int Sign>
+    _Compiletime void updateHidden(U64 squares);
+    _Compiletime void refreshHidden();
+
+    template <U8 Size, bool White, bool Check, GenMode Mode>
+    _Compiletime void genPawnMoves(MoveList<> &moves, const TimelineInfo &info, const U64 legalMask, const U64 notPin, const U64 notPinHV, const U64 notPinD12, const TMask &tMask, const U64 timeChecks, const U64 discover) const;
     template <U8 Size, bool White>
-    _Compiletime void genCastle(std::vector<Move> &moves, const TimelineInfo &info, const U64 banMask) const;
+    _Compiletime void genCastle(MoveList<> &moves, const TimelineInfo &info, const U64 banMask) const;
 
     template <bool White, MoveType Type>
     _Compiletime void makeMove(const Move &move);
@@ -113,14 +320,15 @@ namespace Chess5D
     _Compiletime void refresh(TimelineInfo &info);
 
     template <U8 Size, bool White>
-    _Compiletime void genBitMoves(std::vector<Move> &moves, const TimelineInfo &info, const U64 &legalMask, const U64 &pastCheckMask) const;
+    _Compiletime void genBitMoves(MoveList<> &moves, const TimelineInfo &info, const U64 &legalMask, const U64 &pastCheckMask) const;
     template <U8 Size, bool White>
-    _Compiletime void genRoyalBitMoves(std::vector<Move> &moves, const TimelineInfo &info, const U64 &pastCheckMask) const;
+    _Compiletime void genRoyalBitMoves(MoveList<> &moves, const TimelineInfo &info, const U64 &pastCheckMask) const;
 
     _Compiletime Board()
     {
       for (U16 i = 0; i < 64; ++i)
         board.mailboxBoard[i] = NoPiece;
+      refreshHidden(); // Boards that were never imported can still be moved onto
     }
   };
 
@@ -240,7 +448,7 @@ namespace Chess5D
   }
 
   template <U8 Set, bool White, bool BitSolver, Direction Dir, MoveType Type>
-  _Compiletime static void pawnMoves(std::vector<Move> &moves, const TimelineInfo &info, U64 &pawn, const U8 &solverSq)
+  _Compiletime static void pawnMoves(MoveList<> &moves, const TimelineInfo &info, U64 &pawn, const U8 &solverSq)
   {
     constexpr bool promo = Type == Promotion || Type == PromoCapture;
 
@@ -270,7 +478,7 @@ namespace Chess5D
   }
 
   template <PieceType Type>
-  _Compiletime static void spatialMoves(std::vector<Move> &moves, const TimelineInfo &info, const U8 &sq, const U64 &movable, const U64 &occ, const U64 &enemy)
+  _Compiletime static void spatialMoves(MoveList<> &moves, const TimelineInfo &info, const U8 &sq, const U64 &movable, const U64 &occ, const U64 &enemy)
   {
     U64 move = Lookup::movement<Type>(sq, occ) & movable;
     U64 cap = move & enemy;
@@ -280,7 +488,7 @@ namespace Chess5D
   }
 
   template <Direction Dir>
-  _Compiletime static void nonSpatialMoves(std::vector<Move> &moves, const TimelineInfo &info, const U8 &sq, U64 move, U64 cap)
+  _Compiletime static void nonSpatialMoves(MoveList<> &moves, const TimelineInfo &info, const U8 &sq, U64 move, U64 cap)
   {
     Bitloop(move)
     {
@@ -305,7 +513,7 @@ namespace Chess5D
   }
 
   template <PieceType diag, PieceType orth>
-  _Compiletime static void travelMaskMoves(std::vector<Move> &moves, const TimelineInfo &info, const TMask &tMask, U64 sq)
+  _Compiletime static void travelMaskMoves(MoveList<> &moves, const TimelineInfo &info, const TMask &tMask, U64 sq)
   {
     U512 d[7];
 
@@ -419,7 +627,88 @@ namespace Chess5D
                          : EMPTY;
   }
 
-  _Compiletime void bitsToMoves(std::vector<Move> &moves, U64 move, MoveType type, U8 sTimeline, U8 sTurn, U8 eTimeline, U8 eTurn, int shift)
+  // Key of the pieces on `squares` and of the castling rights of the kings and rooks among them
+  template <U8 Set>
+  _Compiletime U64 Board<Set>::squaresKey(U64 squares) const
+  {
+    const U64 rights = board.unmoved & (bitBoard(true, PieceType(3)) | bitBoard(false, PieceType(3)) | bitBoard(true, PieceType(5)) | bitBoard(false, PieceType(5)));
+    U64 key = 0;
+    Bitloop(squares)
+    {
+      const U8 sq = SquareOf(squares);
+      if (board.mailboxBoard[sq] != NoPiece)
+        key ^= zobrist.piece[sq][board.mailboxBoard[sq]];
+      if (rights >> sq & 1)
+        key ^= zobrist.unmoved[sq];
+    }
+    return key;
+  }
+
+  // Refresh may drop the en passant target after a move, so it is hashed when the key is taken
+  template <U8 Set>
+  _Compiletime U64 Board<Set>::epKey() const
+  {
+    U64 key = 0;
+    U64 epTarget = board.epTarget;
+    Bitloop(epTarget) key ^= zobrist.ep[SquareOf(epTarget) % 8];
+    return key;
+  }
+
+  template <U8 Set>
+  _Compiletime U64 Board<Set>::fullHash() const
+  {
+    return squaresKey(FULL);
+  }
+
+  // What the pieces on `squares` and the castling rights among them add to the running sums
+  template <U8 Set>
+  _Compiletime Accumulator Board<Set>::squaresSum(U64 squares) const
+  {
+    const U64 rights = board.unmoved & (bitBoard(true, PieceType(3)) | bitBoard(false, PieceType(3)) | bitBoard(true, PieceType(5)) | bitBoard(false, PieceType(5)));
+    Accumulator sum;
+    Bitloop(squares)
+    {
+      const U8 sq = SquareOf(squares);
+      const Piece piece = board.mailboxBoard[sq];
+      sum.material += pieceValues.material[piece];
+      if constexpr (PIECE_SQUARES)
+        sum.psq += pieceValues.square[sq][piece];
+      if (rights >> sq & 1)
+        sum.castling += board.white >> sq & 1 ? 1 : -1;
+    }
+    return sum;
+  }
+
+  template <U8 Set>
+  _Compiletime Accumulator Board<Set>::fullSum() const
+  {
+    return squaresSum(FULL);
+  }
+
+  // Adds the network inputs of the pieces on `squares` to the first layer, or removes them, without NNUE it does nothing
+  template <U8 Set>
+  template <int Sign>
+  _Compiletime void Board<Set>::updateHidden(U64 squares)
+  {
+#ifdef NNUE
+    Bitloop(squares)
+    {
+      const U8 sq = SquareOf(squares);
+      if (board.mailboxBoard[sq] != NoPiece)
+        network.template update<Sign>(board.hidden, pieceFeature(board.mailboxBoard[sq], sq));
+    }
+#endif
+  }
+
+  template <U8 Set>
+  _Compiletime void Board<Set>::refreshHidden()
+  {
+#ifdef NNUE
+    network.refresh(board.hidden, board.mailboxBoard);
+#endif
+  }
+
+  _Compiletime void bitsToMoves(MoveList<> &moves, U64 move, MoveType type, U8 sTimeline, U8 sTurn, U8 eTimeline, U8 eTurn, int shift)
   {
     Bitloop(move)
     {
@@ -429,14 +718,14 @@ namespace Chess5D
   }
 
   template <bool HasSq = true>
-  _Compiletime void jumpMoves(std::vector<Move> &moves, U64 move, U64 cap, U8 sq, U8 sTimeline, U8 sTurn, LT shift)
+  _Compiletime void jumpMoves(MoveList<> &moves, U64 move, U64 cap, U8 sq, U8 sTimeline, U8 sTurn, LT shift)
   {
     Bitloop(move) moves.emplace_back(HasSq ? sq : SquareOf(move), SquareOf(move), 0, 0, Travel, sTimeline, sTurn, sTimeline + shift.timeline, sTurn + 2 * shift.turn);
     Bitloop(cap) moves.emplace_back(HasSq ? sq : SquareOf(cap), SquareOf(cap), 0, 0, TravelCapture, sTimeline, sTurn, sTimeline + shift.timeline, sTurn + 2 * shift.turn);
   }
 
   template <bool Royal>
-  _Compiletime void kingTravels(std::vector<Move> &moves, U8 sq, U8 sTimeline, U8 sTurn, TMask tMask)
+  _Compiletime void kingTravels(MoveList<> &moves, U8 sq, U8 sTimeline, U8 sTurn, TMask tMask)
   {
     U512 kingAttack = U512Set1(Lookup::KingTravels[sq]);
 
@@ -453,7 +742,7 @@ namespace Chess5D
     jumpMoves(moves, move[6], cap[6], sq, sTimeline, sTurn, dirShift<SouthEast>());
   }
 
-  _Compiletime void knightTravels(std::vector<Move> &moves, U8 sq, U8 sTimeline, U8 sTurn, TMask tMask)
+  _Compiletime void knightTravels(MoveList<> &moves, U8 sq, U8 sTimeline, U8 sTurn, TMask tMask)
   { // excludes strictly-LT
     U512 knightAttack = U512Set(Lookup::Knight1Attacks[sq], Lookup::Knight2Attacks[sq], Lookup::Knight1Attacks[sq], Lookup::Knight2Attacks[sq],
                                 Lookup::Knight1Attacks[sq], Lookup::Knight2Attacks[sq], 0, 0);
@@ -480,8 +769,8 @@ namespace Chess5D
   }
 
   template <U8 Set>
-  template <U8 Size, bool White, bool Check>
-  _Compiletime void Board<Set>::genPawnMoves(std::vector<Move> &moves, const TimelineInfo &info, const U64 legalMask, const U64 notPin, const U64 notPinHV, const U64 notPinD12, const TMask &tMask) const
+  template <U8 Size, bool White, bool Check, GenMode Mode>
+  _Compiletime void Board<Set>::genPawnMoves(MoveList<> &moves, const TimelineInfo &info, const U64 legalMask, const U64 notPin, const U64 notPinHV, const U64 notPinD12, const TMask &tMask, const U64 timeChecks, const U64 discover) const
   {
     constexpr U64 lastRank = White ? 0xffull << (8 * Size - 8) : 0xffull;
 
@@ -492,19 +781,37 @@ namespace Chess5D
     const U64 empty = ~board.occ;
     const U64 enemy = (bitBoard(!White, NoType) | pawnShift<White, North>(board.epTarget)) & legalMask;
 
-    U64 pawnF = pawnHV & pawnShift<!White, North>(empty);
-    U64 pawnP = pawnF & board.unmoved & pawnShift<!White, South>(empty & legalMask);
-    pawnF &= pawnShift<!White, North>(legalMask);
+    U64 pawnF = EMPTY;
+    U64 pawnP = EMPTY;
+    if (Mode != GenCaptures)
+    {
+      pawnF = pawnHV & pawnShift<!White, North>(empty);
+      pawnP = pawnF & board.unmoved & pawnShift<!White, South>(empty & legalMask);
+      pawnF &= pawnShift<!White, North>(legalMask);
 
-    U64 pawnR = pawnLR & pawnShift<!White, NorthWest>(enemy & Not<West>());
-    U64 pawnL = pawnLR & pawnShift<!White, NorthEast>(enemy & Not<East>());
+      if (Mode == GenQuietChecks) // Pawns that uncover a slider keep every push, as in modePieceMoves
+      {
+        const U64 royal = royalty(!White);
+        const U64 checks = pawnShift<!White, NorthWest>(royal & Not<West>()) | pawnShift<!White, NorthEast>(royal & Not<East>());
+        pawnF &= pawnShift<!White, North>(checks | timeChecks | lastRank) | discover;
+        pawnP &= pawnShift<!White, South>(checks | timeChecks) | discover;
+      }
+    }
+
+    U64 pawnR = EMPTY;
+    U64 pawnL = EMPTY;
+    if (Mode != GenQuietChecks)
+    {
+      pawnR = pawnLR & pawnShift<!White, NorthWest>(enemy & Not<West>());
+      pawnL = pawnLR & pawnShift<!White, NorthEast>(enemy & Not<East>());
+    }
 
     pawnPrune<White, North>(info, pawnF);
     pawnPrune<White, South>(info, pawnP);
     pawnPrune<White, NorthWest>(info, pawnR);
     pawnPrune<White, NorthEast>(info, pawnL);
 
-    if (board.epTarget)
+    if (Mode != GenQuietChecks && board.epTarget)
     {
       const U64 pawnEPR = pawnR & (board.epTarget & Not<West>()) >> 1;
       const U64 pawnEPL = pawnL & (board.epTarget & Not<East>()) << 1;
@@ -544,7 +851,7 @@ namespace Chess5D
     pawnMoves<Set, White, false, NorthEast, Capture>(moves, info, pawnR, 0);
     pawnMoves<Set, White, false, NorthWest, Capture>(moves, info, pawnL, 0);
 
-    if (!Check)
+    if (!Check && Mode == GenAll)
     {
       U64 brawns = 0;
       if (Set > WBrawn)
@@ -561,14 +868,14 @@ namespace Chess5D
       U64 move2 = move & board.unmoved & ~tMask.o[1][dirShift] & tMask.m[1][dirShift];
       move &= tMask.m[0][dirShift];
 
-      bitsToMoves(moves, move, Travel, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn, 0);
-      bitsToMoves(moves, move2, Travel, info.timeline, info.turn, info.timeline + White ? 2 : -2, info.turn, 0);
+      bitsToMoves(moves, move, Travel, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn, 0);
+      bitsToMoves(moves, move2, Travel, info.timeline, info.turn, info.timeline + (White ? 2 : -2), info.turn, 0);
 
       move = pawnlike & tMask.e[0][dirShiftL] & tMask.m[0][dirShiftL];
-      bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn - 2, 0);
+      bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn - 2, 0);
 
       move = pawnlike & tMask.e[0][dirShiftR] & tMask.m[0][dirShiftR];
-      bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn + 2, 0);
+      bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn + 2, 0);
 
       if (Set > WBrawn)
       {
@@ -603,7 +910,7 @@ namespace Chess5D
         move = pawnShift<White, North>(brawns) & tMask.e[0][dirShift] & tMask.m[0][dirShift];
         promoMoves = move & lastRank;
         move ^= promoMoves;
-        bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn, pawnSquare<!White, North>(0));
+        bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn, pawnSquare<!White, North>(0));
 
         Bitloop(promoMoves)
         {
@@ -611,35 +918,35 @@ namespace Chess5D
           const U8 to = pawnSquare<White, North>(sq);
 
           if (Set > WKnight)
-            moves.emplace_back(sq, to, toPiece(White, Knight), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, Knight), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
           if (Set > WBishop)
-            moves.emplace_back(sq, to, toPiece(White, Bishop), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, Bishop), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
           if (Set > WRook)
-            moves.emplace_back(sq, to, toPiece(White, Rook), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, Rook), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
           if (Set > WQueen)
-            moves.emplace_back(sq, to, toPiece(White, Queen), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, Queen), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
           if (Set > WPrincess)
-            moves.emplace_back(sq, to, toPiece(White, Princess), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, Princess), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
           if (Set > WCKing)
-            moves.emplace_back(sq, to, toPiece(White, CKing), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, CKing), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
           if (Set > WUnicorn)
-            moves.emplace_back(sq, to, toPiece(White, Unicorn), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, Unicorn), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
           if (Set > WDragon)
-            moves.emplace_back(sq, to, toPiece(White, Dragon), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn);
+            moves.emplace_back(sq, to, toPiece(White, Dragon), 0, TravelPromoCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn);
         }
 
         move = (brawns >> 1 & Not<West>()) & tMask.e[dirShift][0] & tMask.m[dirShift][0];
-        bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn, 1);
+        bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn, 1);
 
         move = (brawns << 1 & Not<East>()) & tMask.e[dirShift][0] & tMask.m[dirShift][0];
-        bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + White ? 1 : -1, info.turn, -1);
+        bitsToMoves(moves, move, TravelCapture, info.timeline, info.turn, info.timeline + (White ? 1 : -1), info.turn, -1);
       }
     }
   }
 
   template <U8 Set>
   template <U8 Size, bool White>
-  _Compiletime void Board<Set>::genCastle(std::vector<Move> &moves, const TimelineInfo &info, const U64 banMask) const
+  _Compiletime void Board<Set>::genCastle(MoveList<> &moves, const TimelineInfo &info, const U64 banMask) const
   {
     U64 king = bitBoard(White, King) & board.unmoved;
     Bitloop(king)
@@ -667,8 +974,8 @@ namespace Chess5D
     }
   }
 
-  template <PieceType Type, bool Check>
-  _Compiletime static void pieceMoves(std::vector<Move> &moves, const TimelineInfo &info, U64 pieces, const U64 &movable, const U64 &occ, const U64 &enemy, const U64 &pin, const TMask &tMask) // honestly should probably be moved to chess.hpp
+  template <PieceType Type, bool Check, GenMode Mode = GenAll>
+  _Compiletime static void pieceMoves(MoveList<> &moves, const TimelineInfo &info, U64 pieces, const U64 &movable, const U64 &occ, const U64 &enemy, const U64 &pin, const TMask &tMask) // honestly should probably be moved to chess.hpp
   {
     constexpr bool pinnable = Type != Knight;
     constexpr bool royal = Type == King || Type == RQueen;
@@ -693,7 +1000,7 @@ namespace Chess5D
         spatialMoves<Type>(moves, info, sq, royal ? movable & info.checkMasks[sq] : movable, occ, enemy);
       }
     }
-    if (!Check || royal)
+    if ((!Check || royal) && Mode == GenAll)
     {
       Bitloop(piecesNoPin)
       {
@@ -728,7 +1035,7 @@ namespace Chess5D
   }
 
   template <bool White, PieceType Type>
-  _Compiletime static void pieceBitMoves(std::vector<Move> &moves, const TimelineInfo &info, U64 pieces, const U64 &movable, const U64 &enemy, const U64 &pin)
+  _Compiletime static void pieceBitMoves(MoveList<> &moves, const TimelineInfo &info, U64 pieces, const U64 &movable, const U64 &enemy, const U64 &pin)
   {
     constexpr bool pinnable = Type != Knight;
     constexpr bool nonRoyal = Type != King && Type != RQueen;
@@ -755,7 +1062,7 @@ namespace Chess5D
 
   template <U8 Set>
   template <U8 Size, bool White>
-  _Compiletime void Board<Set>::genBitMoves(std::vector<Move> &moves, const TimelineInfo &info, const U64 &legalMask, const U64 &pastCheckMask) const
+  _Compiletime void Board<Set>::genBitMoves(MoveList<> &moves, const TimelineInfo &info, const U64 &legalMask, const U64 &pastCheckMask) const
   {
     constexpr U64 lastRank = 0xffull | 0xffull << (8 * Size - 8);
     constexpr U64 mask = Size == 1 ? 0x0000000000000001 : Size == 2 ? 0x0000000000000303
@@ -821,7 +1128,7 @@ namespace Chess5D
 
   template <U8 Set>
   template <U8 Size, bool White>
-  _Compiletime void Board<Set>::genRoyalBitMoves(std::vector<Move> &moves, const TimelineInfo &info, const U64 &pastCheckMask) const
+  _Compiletime void Board<Set>::genRoyalBitMoves(MoveList<> &moves, const TimelineInfo &info, const U64 &pastCheckMask) const
   {
     constexpr U64 mask = Size == 1 ? 0x0000000000000001 : Size == 2 ? 0x0000000000000303
                                                       : Size == 3   ? 0x0000000000070707
@@ -863,6 +1170,10 @@ namespace Chess5D
                               : 1ull << move.from | 1ull << move.to;
 
     const Piece piece = board.mailboxBoard[move.from];
+    const U64 touched = fromTo | to;
+    board.hash ^= squaresKey(touched);
+    board.sums -= squaresSum(touched);
+    updateHidden<-1>(touched);
 
     if(castle){
       bitBoard<White, King>() ^= from;
@@ -891,7 +1202,9 @@ namespace Chess5D
                                                                             : piece;
     if (enpassant)
       board.mailboxBoard[move.special1] = NoPiece;
-      
+    board.hash ^= squaresKey(touched);
+    board.sums += squaresSum(touched);
+    updateHidden<1>(touched);
   }
 
   template <U8 Set>
@@ -899,6 +1212,9 @@ namespace Chess5D
   _Compiletime void Board<Set>::makeMoveTravel(const Move &move, Piece piece)
   {
     const U64 to = 1ull << move.to;
+    board.hash ^= squaresKey(to);
+    board.sums -= squaresSum(to);
+    updateHidden<-1>(to);
     board.bitBoard[piece] ^= to;
     if (Capture)
     {
@@ -913,6 +1229,9 @@ namespace Chess5D
     bitBoard<White, NoType>() ^= to;
     board.epTarget = 0;
     board.mailboxBoard[move.to] = piece;
+    board.hash ^= squaresKey(to);
+    board.sums += squaresSum(to);
+    updateHidden<1>(to);
   }
 
   template <U8 Set>
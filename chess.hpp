@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstring>
 #include <sstream>
 #include <iostream>
 #include <string>
@@ -9,6 +10,39 @@
 
 namespace Chess5D
 {
+  // Squares from which each piece class attacks an enemy royal piece on another board, see timeAttacks
+  struct TimeAttacks
+  {
+    U64 bishop{EMPTY};
+    U64 rook{EMPTY};
+    U64 unicorn{EMPTY};
+    U64 dragon{EMPTY};
+    U64 knight{EMPTY};   // Royalty a knight reaches without moving on the board
+    U64 knightD1{EMPTY}; // Royalty one step away in time or timeline
+    U64 knightD2{EMPTY}; // Royalty two steps away in time or timeline
+    U64 king{EMPTY};
+    U64 pawn{EMPTY};
+    U64 brawn{EMPTY};
+  };
+
+  // Everything givesCheck needs about one headboard, computed once per node and shared by all of its moves
+  struct CheckInfo
+  {
+    U64 royal{EMPTY};        // Enemy royal pieces on the board
+    U64 timeCheckers{EMPTY}; // Own pieces already attacking enemy royalty through time
+    TimeAttacks time;        // Time attacks from the board the move is made onto
+  };
+
+  // Neighbourhood summaries of a timeline's headboard, kept until a board they were built from is written
+  struct MaskCache
+  {
+    TMask tMask;
+    U64 tMaskStamp{0}; // Chess::changes when tMask was built, 0 if never
+    U64 pastStamp{0};  // Same for the headboard's pastCheck
+    U8 tMaskTurn{0};
+    U8 pastTurn{0};
+  };
+
   template <U8 Set, U8 Size, U16 L, U16 T>
   struct Chess
   {
@@ -20,12 +54,34 @@ namespace Chess5D
     U8 activeNum[2]{0, 0};
     U8 present=0; //should be stored and updated each time a moveset is made
 
+    // Board writes are counted so that cached masks know whether anything within their reach changed since
+    U64 changes = 0; // Wide enough to never wrap, a wrapped count would make a changed board look older than a stamp
+    U64 changed[L + 16][2]{}; // Value of changes at the last write to a board of each turn parity of a timeline
+    MaskCache maskCache[L + 16]{};
+    U64 hash = 0; // Zobrist key of every existing board at its coordinates, see boardKey
+
     template <bool White>
     _Compiletime void makeMove(const Move &move);
     template <bool White>
     _Compiletime void undoMove(const Move &move);
+    template <bool White, GenMode Mode = GenAll>
+    _Compiletime void generateMoves(MoveList<> &moves, U16 timeline, const TimeAttacks &time = {});
     template <bool White>
-    _Compiletime void generateMoves(std::vector<Move> &moves, U16 timeline);
+    _Compiletime int playableTimeline(int from = 0) const;
+    template <bool White>
+    _Compiletime void updatePastCheck(U16 timeline);
+    template <bool White>
+    _Compiletime const TMask &travelMaskCache(U16 timeline);
+    _Compiletime void touch(U16 timeline, U8 turn);
+    _Compiletime bool changedSince(U16 timeline, U8 radius, U64 stamp, U8 parities) const;
+    _Compiletime U64 boardKey(U16 timeline, U8 turn) const;
+    _Compiletime U64 fullHash() const;
+    template <bool White>
+    _Compiletime CheckInfo checkInfo(U16 timeline) const;
+    template <bool White>
+    _Compiletime bool givesCheck(const Move &move, const CheckInfo &info) const;
+    template <bool White>
+    _Compiletime bool givesCheck(const Move &move) const;
     template <bool isWhite>
     _Compiletime std::string moveToPGN(Move move);
     template <bool White>
@@ -153,36 +209,37 @@ namespace Chess5D
     return notation;
   }
 
-  template <U8 Set, bool White>
-  _Compiletime void refreshMask(Board<Set> *brd)
+  template <U8 Set, bool White, typename Mask>
+  _Compiletime void fillPastMask(const Board<Set> *brd, Mask &mask)
   {
     const U64 royalty = (brd - 1)->royalty(White);
     const U64 notOcc = ~(brd - 1)->board.occ;
-    brd->pastMask.center = ((notOcc & (brd - 2)->pastMask.center) | royalty);
-    brd->pastMask.north = ((notOcc & (brd - 2)->pastMask.north) | royalty) << 8;
-    brd->pastMask.east = ((notOcc & (brd - 2)->pastMask.east & Not<East>()) | royalty) << 1;
-    brd->pastMask.south = ((notOcc & (brd - 2)->pastMask.south) | royalty) >> 8;
-    brd->pastMask.west = ((notOcc & (brd - 2)->pastMask.west & Not<West>()) | royalty) >> 1;
-    brd->pastMask.northeast = ((notOcc & (brd - 2)->pastMask.northeast & Not<East>()) | royalty) << 9;
-    brd->pastMask.southeast = ((notOcc & (brd - 2)->pastMask.southeast & Not<East>()) | royalty) >> 7;
-    brd->pastMask.southwest = ((notOcc & (brd - 2)->pastMask.southwest & Not<West>()) | royalty) >> 9;
-    brd->pastMask.northwest = ((notOcc & (brd - 2)->pastMask.northwest & Not<West>()) | royalty) << 7;
+    mask.center = ((notOcc & (brd - 2)->pastMask.center) | royalty);
+    mask.north = ((notOcc & (brd - 2)->pastMask.north) | royalty) << 8;
+    mask.east = ((notOcc & (brd - 2)->pastMask.east & Not<East>()) | royalty) << 1;
+    mask.south = ((notOcc & (brd - 2)->pastMask.south) | royalty) >> 8;
+    mask.west = ((notOcc & (brd - 2)->pastMask.west & Not<West>()) | royalty) >> 1;
+    mask.northeast = ((notOcc & (brd - 2)->pastMask.northeast & Not<East>()) | royalty) << 9;
+    mask.southeast = ((notOcc & (brd - 2)->pastMask.southeast & Not<East>()) | royalty) >> 7;
+    mask.southwest = ((notOcc & (brd - 2)->pastMask.southwest & Not<West>()) | royalty) >> 9;
+    mask.northwest = ((notOcc & (brd - 2)->pastMask.northwest & Not<West>()) | royalty) << 7;
   }
 
-  template <U8 Set, U16 T, bool White>
-  _Compiletime void createMask(Board<Set> *brd)  
+  template <U8 Set, bool White>
+  _Compiletime void refreshMask(Board<Set> *brd)
+  {
+    fillPastMask<Set, White>(brd, brd->pastMask);
+  }
+
+  // Squares from which each piece class of !White on `brd` attacks a royal piece of White on another board.
+  // Only other boards and `pastMask` are read, so it can be filled in for a board before a move is made onto it.
+  template <U8 Set, U16 T, bool White, typename Mask>
+  _Compiletime TimeAttacks timeAttacks(const Board<Set> *brd, const Mask &pastMask)
   {
     constexpr U512 notE = {Not<East>(), Not<East>(), Not<East>(), 0, Not<East>(), Not<East>(), Not<East>(), 0};
     constexpr U512 notW = {Not<West>(), Not<West>(), Not<West>(), 0, Not<West>(), Not<West>(), Not<West>(), 0};
-
-    const U64 rook = brd->rooks(!White, true);
-    const U64 bishop = brd->bishops(!White, true);
-    const U64 unicorn = brd->unicorns(!White, true);
-    const U64 dragon = brd->dragons(!White, true);
-
-    const U512 center = U512Set(0, bishop, rook, bishop, rook, bishop, rook, bishop);
-    const U512 orth = U512Set(0, unicorn, bishop, unicorn, bishop, unicorn, bishop, unicorn);
-    const U512 diag = U512Set(0, dragon, unicorn, dragon, unicorn, dragon, unicorn, dragon);
+    constexpr U512 odd = {0, FULL, 0, FULL, 0, FULL, 0, FULL};
+    constexpr U512 even = {0, 0, FULL, 0, FULL, 0, FULL, 0};
 
     U512 o[6];
     U512 r[7];
@@ -213,115 +270,283 @@ namespace Chess5D
     }
 
     //Assumes all boards are loaded correctly
-    maskC[4] = brd->pastMask.center;
-    maskN[4] = brd->pastMask.north;
-    maskE[4] = brd->pastMask.east;
-    maskS[4] = brd->pastMask.south;
-    maskW[4] = brd->pastMask.west;
-    maskNE[4] = brd->pastMask.northeast;
-    maskSE[4] = brd->pastMask.southeast;
-    maskSW[4] = brd->pastMask.southwest;
-    maskNW[4] = brd->pastMask.northwest;
-    
+    maskC[4] = pastMask.center;
+    maskN[4] = pastMask.north;
+    maskE[4] = pastMask.east;
+    maskS[4] = pastMask.south;
+    maskW[4] = pastMask.west;
+    maskNE[4] = pastMask.northeast;
+    maskSE[4] = pastMask.southeast;
+    maskSW[4] = pastMask.southwest;
+    maskNW[4] = pastMask.northwest;
+
+    // Even lanes step straight along the timeline or turn axis and odd lanes diagonally, which decides the piece class
+    const U512 orth = maskN | maskE | maskW | maskS;
+    const U512 diag = maskNE | maskSE | maskSW | maskNW;
+
+    TimeAttacks attacks;
+    attacks.bishop = U512_REDUCE_OR((maskC & odd) | (orth & even));
+    attacks.rook = U512_REDUCE_OR(maskC & even);
+    attacks.unicorn = U512_REDUCE_OR((orth & odd) | (diag & even));
+    attacks.dragon = U512_REDUCE_OR(diag & odd);
+
+    attacks.knight = (brd + T - 3)->royalty(White) | (brd + T + 5)->royalty(White) | (brd + T*2 - 1)->royalty(White) | (brd + T*2 + 3)->royalty(White) | (brd - T - 3)->royalty(White) | (brd - T + 5)->royalty(White) | (brd - T*2 - 1)->royalty(White) | (brd - T*2 + 3)->royalty(White);
+    attacks.knightD1 = (brd - 1)->royalty(White) | (brd + T + 1)->royalty(White) | (brd - T + 1)->royalty(White);
+    attacks.knightD2 = (brd - 3)->royalty(White) | (brd + T*2 + 1)->royalty(White) | (brd - T*2 + 1)->royalty(White);
+    attacks.king = (brd - 1)->royalty(White) | U512_REDUCE_OR(r[0]);
+
+    constexpr short f1 = White ? -T : T;
+    attacks.pawn = (brd + f1 - 1)->royalty(White) | (brd + f1 + 3)->royalty(White);
+
+    const U64 royaltyBrawnsLR = (brd + f1 + 1)->royalty(White);
+    const U64 royaltyBrawnsF = royaltyBrawnsLR | attacks.pawn;
+    attacks.brawn = pawnShift<!White, North>(royaltyBrawnsF) | (royaltyBrawnsLR & Not<East>()) << 1 | (royaltyBrawnsLR & Not<West>()) >> 1;
+    return attacks;
+  }
+
+  _Compiletime bool knightTimeAttack(const TimeAttacks &attacks, const U8 sq)
+  {
+    return (attacks.knight >> sq & 1) || (Lookup::Knight1Attacks[sq] & attacks.knightD1) || (Lookup::Knight2Attacks[sq] & attacks.knightD2);
+  }
 
-    const U64 maskSlider = U512_REDUCE_OR((center & maskC) | (orth & maskN) | (orth & maskE) | (orth & maskW) | (orth & maskS) | (diag & maskNE) | (diag & maskSE) | (diag & maskSW) | (diag & maskNW));
+  _Compiletime bool kingTimeAttack(const TimeAttacks &attacks, const U8 sq)
+  {
+    return (attacks.king >> sq & 1) || (Lookup::movement<King>(sq, 0) & attacks.king);
+  }
 
+  // Squares from which a piece of the given type attacks a royal piece through time, everywhere timeAttack is true
+  template <PieceType Type>
+  _Compiletime U64 timeCheckSquares(const TimeAttacks &attacks)
+  {
+    U64 squares = EMPTY;
+    if (Type == Knight)
+    {
+      squares = attacks.knight;
+      U64 d1 = attacks.knightD1;
+      U64 d2 = attacks.knightD2;
+      Bitloop(d1) squares |= Lookup::Knight1Attacks[SquareOf(d1)];
+      Bitloop(d2) squares |= Lookup::Knight2Attacks[SquareOf(d2)];
+    }
+    else if (Type == King || Type == CKing)
+    {
+      squares = attacks.king;
+      U64 king = attacks.king;
+      Bitloop(king) squares |= Lookup::movement<King>(SquareOf(king), 0);
+    }
+    else if (Type == Pawn || Type == Brawn)
+      squares = attacks.pawn | (Type == Brawn ? attacks.brawn : EMPTY);
+    else
+      squares = (Type == Bishop || Type == Princess || Type == Queen || Type == RQueen ? attacks.bishop : EMPTY) |
+                (Type == Rook || Type == Princess || Type == Queen || Type == RQueen ? attacks.rook : EMPTY) |
+                (Type == Unicorn || Type == Queen || Type == RQueen ? attacks.unicorn : EMPTY) |
+                (Type == Dragon || Type == Queen || Type == RQueen ? attacks.dragon : EMPTY);
+    return squares;
+  }
+
+  // Pieces of !White on `brd` that attack a royal piece of White through time
+  template <U8 Set, bool White>
+  _Compiletime U64 timeCheckers(const Board<Set> *brd, const TimeAttacks &attacks)
+  {
+    const U64 maskSlider = (brd->bishops(!White, true) & attacks.bishop) | (brd->rooks(!White, true) & attacks.rook) |
+                           (brd->unicorns(!White, true) & attacks.unicorn) | (brd->dragons(!White, true) & attacks.dragon);
+
+    U64 maskKnight = EMPTY;
     U64 knight = brd->bitBoard(!White, Knight);
-    U64 maskKnight = knight & ((brd + T - 3)->royalty(White) | (brd + T + 5)->royalty(White) | (brd + T*2 - 1)->royalty(White) | (brd + T*2 + 3)->royalty(White) | (brd - T - 3)->royalty(White) | (brd - T + 5)->royalty(White) | (brd - T*2 - 1)->royalty(White) | (brd - T*2 + 3)->royalty(White));
-    const U64 royaltyKnightD1 = (brd - 1)->royalty(White) | (brd + T + 1)->royalty(White) | (brd - T + 1)->royalty(White);
-    const U64 royaltyKnightD2 = (brd - 3)->royalty(White) | (brd + T*2 + 1)->royalty(White) | (brd - T*2 + 1)->royalty(White);
     Bitloop(knight)
     {
       const U8 sq = SquareOf(knight);
-      maskKnight |= 1ull << sq & -((Lookup::Knight1Attacks[sq] & royaltyKnightD1 | Lookup::Knight2Attacks[sq] & royaltyKnightD2) != 0);
+      maskKnight |= 1ull << sq & -U64(knightTimeAttack(attacks, sq));
     }
 
+    U64 maskKing = EMPTY;
     U64 king = brd->kings(!White, true);
-    const U64 royaltyKing = (brd - 1)->royalty(White) | U512_REDUCE_OR(r[0]);
-    U64 maskKing = king & royaltyKing;
     Bitloop(king)
     {
       const U8 sq = SquareOf(king);
-      maskKing |= 1ull << sq & -((Lookup::movement<King>(sq, 0) & royaltyKing) != 0);
+      maskKing |= 1ull << sq & -U64(kingTimeAttack(attacks, sq));
     }
 
-    constexpr short f1 = White ? -T : T;
-    const U64 maskPawn = brd->pawns(!White) & ((brd + f1 - 1)->royalty(White) | (brd + f1 + 3)->royalty(White));
+    const U64 maskPawn = brd->pawns(!White) & attacks.pawn;
+    const U64 maskBrawn = Set > WBrawn ? brd->bitBoard(!White, Brawn) & attacks.brawn : EMPTY;
 
-    const U64 royaltyBrawnsLR = (brd + f1 + 1)->royalty(White);
-    const U64 royaltyBrawnsF = royaltyBrawnsLR | (brd + f1 - 1)->royalty(White) | (brd + f1 + 3)->royalty(White);
-    const U64 maskBrawn = brd->bitBoard(!White, Brawn) & (pawnShift<!White, North>(royaltyBrawnsF) | (royaltyBrawnsLR & Not<East>()) << 1 | (royaltyBrawnsLR & Not<West>()) >> 1);
+    return maskSlider | maskKnight | maskKing | maskPawn | maskBrawn;
+  }
+
+  // Whether a single piece of !White standing on `sq` attacks a royal piece of White through time
+  _Compiletime bool timeAttack(const TimeAttacks &attacks, const PieceType type, const U8 sq)
+  {
+    const U64 bit = 1ull << sq;
+    switch (type)
+    {
+    case Pawn:
+      return attacks.pawn & bit;
+    case Brawn:
+      return (attacks.pawn | attacks.brawn) & bit;
+    case Knight:
+      return knightTimeAttack(attacks, sq);
+    case King:
+    case CKing:
+      return kingTimeAttack(attacks, sq);
+    case Bishop:
+      return attacks.bishop & bit;
+    case Rook:
+      return attacks.rook & bit;
+    case Princess:
+      return (attacks.bishop | attacks.rook) & bit;
+    case Unicorn:
+      return attacks.unicorn & bit;
+    case Dragon:
+      return attacks.dragon & bit;
+    case Queen:
+    case RQueen:
+      return (attacks.bishop | attacks.rook | attacks.unicorn | attacks.dragon) & bit;
+    default:
+      return false;
+    }
+  }
 
-    brd->pastCheck = maskSlider | maskKnight | maskKing | maskPawn | maskBrawn;
+  template <U8 Set, U16 T, bool White>
+  _Compiletime void createMask(Board<Set> *brd)
+  {
+    brd->pastCheck = timeCheckers<Set, White>(brd, timeAttacks<Set, T, White>(brd, brd->pastMask));
+  }
+
+  // Attacks of a single piece of White standing on `sq`
+  template <U8 Set, bool White>
+  _Compiletime U64 pieceAttacks(const PieceType type, const U8 sq, const U64 occ)
+  {
+    const U64 bit = 1ull << sq;
+    switch (type)
+    {
+    case Pawn:
+    case Brawn:
+      return pawnShift<White, NorthWest>(bit & Not<West>()) | pawnShift<White, NorthEast>(bit & Not<East>());
+    case Knight:
+      return Lookup::movement<Knight>(sq, occ);
+    case Bishop:
+      return Lookup::movement<Bishop>(sq, occ);
+    case Rook:
+      return Lookup::movement<Rook>(sq, occ);
+    case Queen:
+      return Lookup::movement<Queen>(sq, occ);
+    case King:
+      return Lookup::movement<King>(sq, occ);
+    case Princess:
+      return Lookup::movement<Princess>(sq, occ);
+    case CKing:
+      return Lookup::movement<CKing>(sq, occ);
+    case RQueen:
+      return Lookup::movement<RQueen>(sq, occ);
+    default: // Unicorns and dragons only attack through time
+      return EMPTY;
+    }
+  }
+
+  // Whether White attacks `royal` on `brd` once the squares in `removed` are vacated, the board occupancy is `occ` and
+  // `attacks` are the attacks of the pieces that arrived. Covers direct and discovered checks.
+  template <U8 Set, bool White>
+  _Compiletime bool spatialCheck(const Board<Set> &brd, U64 royal, const U64 occ, const U64 removed, const U64 attacks)
+  {
+    const U64 rooks = brd.rooks(White, true) & ~removed;
+    const U64 bishops = brd.bishops(White, true) & ~removed;
+    if (royal & attacks)
+      return true;
+    Bitloop(royal)
+    {
+      const U8 sq = SquareOf(royal);
+      if ((Lookup::movement<Rook>(sq, occ) & rooks) | (Lookup::movement<Bishop>(sq, occ) & bishops))
+        return true;
+    }
+    return false;
+  }
+
+#ifdef GEN_TRAFFIC
+  // Built with `traffic`, move generation counts the boards it used to copy whole and the bytes it now reads from them
+  struct GenTraffic
+  {
+    U64 boards = 0; // Boards that were passed or gathered by value, each a sizeof(Board) copy
+    U64 bytes = 0;  // Bytes now read from the neighbouring ones, the head board is read in place
+  };
+  inline thread_local GenTraffic genTraffic;
+#endif
+
+  // `boards` boards were read, `fields` 64 bit fields of each. Without GEN_TRAFFIC it does nothing.
+  inline void countTraffic(int boards, int fields)
+  {
+#ifdef GEN_TRAFFIC
+    genTraffic.boards += boards;
+    genTraffic.bytes += boards * fields * sizeof(U64);
+#endif
   }
 
   template <U8 Set, U16 L, U16 T, bool White>
-  _Compiletime TMask travelMasks(Board<Set> (&boards)[L + 16][T + 32], U8 timeline, U8 turn)
+  _Compiletime TMask travelMasks(const Board<Set> (&boards)[L + 16][T + 32], U8 timeline, U8 turn)
   {
 
     TMask tMask;
     for (int i = 0; i < 7; ++i)
     { // i=distance from board
-      Board<Set> brds[7] = {
-          boards[timeline + (i + 1)][turn + 2 * (i + 1)],
-          boards[timeline + (i + 1)][turn],
-          boards[timeline + (i + 1)][turn - 2 * (i + 1)],
-          boards[timeline][turn - 2 * (i + 1)],
-          boards[timeline - (i + 1)][turn - 2 * (i + 1)],
-          boards[timeline - (i + 1)][turn],
-          boards[timeline - (i + 1)][turn + 2 * (i + 1)]};
+      const Board<Set> *brds[7] = {
+          &boards[timeline + (i + 1)][turn + 2 * (i + 1)],
+          &boards[timeline + (i + 1)][turn],
+          &boards[timeline + (i + 1)][turn - 2 * (i + 1)],
+          &boards[timeline][turn - 2 * (i + 1)],
+          &boards[timeline - (i + 1)][turn - 2 * (i + 1)],
+          &boards[timeline - (i + 1)][turn],
+          &boards[timeline - (i + 1)][turn + 2 * (i + 1)]};
+      countTraffic(7, 5);
 
       tMask.o[i] = U512Set(
-          brds[0].board.occ,
-          brds[1].board.occ,
-          brds[2].board.occ,
-          brds[3].board.occ,
-          brds[4].board.occ,
-          brds[5].board.occ,
-          brds[6].board.occ,
+          brds[0]->board.occ,
+          brds[1]->board.occ,
+          brds[2]->board.occ,
+          brds[3]->board.occ,
+          brds[4]->board.occ,
+          brds[5]->board.occ,
+          brds[6]->board.occ,
           0);
 
       const U512 c = U512Set(
-          brds[0].checkMask,
-          brds[1].checkMask,
-          brds[2].checkMask,
-          brds[3].checkMask,
-          brds[4].checkMask,
-          brds[5].checkMask,
-          brds[6].checkMask,
+          brds[0]->checkMask,
+          brds[1]->checkMask,
+          brds[2]->checkMask,
+          brds[3]->checkMask,
+          brds[4]->checkMask,
+          brds[5]->checkMask,
+          brds[6]->checkMask,
           0);
 
       // TODO: these two can maybe be combined without assigning them and entered into m[i]
       const U512 em = U512Set(
-          brds[0].bitBoard(White, NoType),
-          brds[1].bitBoard(White, NoType),
-          brds[2].bitBoard(White, NoType),
-          brds[3].bitBoard(White, NoType),
-          brds[4].bitBoard(White, NoType),
-          brds[5].bitBoard(White, NoType),
-          brds[6].bitBoard(White, NoType),
+          brds[0]->bitBoard(White, NoType),
+          brds[1]->bitBoard(White, NoType),
+          brds[2]->bitBoard(White, NoType),
+          brds[3]->bitBoard(White, NoType),
+          brds[4]->bitBoard(White, NoType),
+          brds[5]->bitBoard(White, NoType),
+          brds[6]->bitBoard(White, NoType),
           0);
 
       tMask.m[i] = c & ~em;
 
       tMask.b[i] = U512Set(
-          brds[0].banMask,
-          brds[1].banMask,
-          brds[2].banMask,
-          brds[3].banMask,
-          brds[4].banMask,
-          brds[5].banMask,
-          brds[6].banMask,
+          brds[0]->banMask,
+          brds[1]->banMask,
+          brds[2]->banMask,
+          brds[3]->banMask,
+          brds[4]->banMask,
+          brds[5]->banMask,
+          brds[6]->banMask,
           0);  
      
       tMask.e[i] = U512Set(
-          brds[0].bitBoard(!White, NoType),
-          brds[1].bitBoard(!White, NoType),
-          brds[2].bitBoard(!White, NoType),
-          brds[3].bitBoard(!White, NoType),
-          brds[4].bitBoard(!White, NoType),
-          brds[5].bitBoard(!White, NoType),
-          brds[6].bitBoard(!White, NoType),
+          brds[0]->bitBoard(!White, NoType),
+          brds[1]->bitBoard(!White, NoType),
+          brds[2]->bitBoard(!White, NoType),
+          brds[3]->bitBoard(!White, NoType),
+          brds[4]->bitBoard(!White, NoType),
+          brds[5]->bitBoard(!White, NoType),
+          brds[6]->bitBoard(!White, NoType),
           0);
           
     }
@@ -329,15 +554,17 @@ namespace Chess5D
   }
 
   template <U8 Size, U8 Set, U16 L, U16 T, bool White, bool Royal, Direction Dir>
-  _Compiletime void genInfMoves(std::vector<Move> &moves, Board<Set> (&boards)[L + 16][T + 32], Board<Set> board, const TimelineInfo &info, U64 pieces)
+  _Compiletime void genInfMoves(MoveList<> &moves, const Board<Set> (&boards)[L + 16][T + 32], const Board<Set> &board, const TimelineInfo &info, U64 pieces)
   {
+    countTraffic(1, 0);
     int dist = 1;
     while (pieces)
     {
       U16 eTimeline = info.timeline + dist * dirShift<Dir>().timeline;
       U16 eTurn = info.turn + 2 * dist * dirShift<Dir>().turn;
 
-      Board<Set> curBrd = boards[eTimeline][eTurn];
+      const Board<Set> &curBrd = boards[eTimeline][eTurn];
+      countTraffic(1, Royal ? 5 : 4);
 
       U64 move = pieces & ~curBrd.bitBoard(White, NoType) & curBrd.checkMask;
       pieces &= ~curBrd.board.occ;
@@ -354,8 +581,54 @@ namespace Chess5D
     }
   }
 
-  template <U8 Size, U8 Set, U16 L, U16 T, bool White, bool Check>
-  _Compiletime void genAllMoves(std::vector<Move> &moves, Board<Set> (&boards)[L + 16][T + 32], Board<Set> board, const TimelineInfo &info, const U64 &legalMask, const U64 &pastCheckMask, const TMask &tMask)
+  // Squares from which a piece of the given type attacks an enemy royal piece on the same board
+  template <U8 Set, bool White, PieceType Type>
+  _Compiletime U64 checkSquares(const Board<Set> &board)
+  {
+    U64 checks = EMPTY;
+    U64 royal = board.royalty(!White);
+    Bitloop(royal) checks |= Lookup::movement<Type>(SquareOf(royal), board.board.occ);
+    return checks;
+  }
+
+  // Own pieces standing alone between an own slider and an enemy royal piece, any of their moves off the line checks
+  template <U8 Set, bool White>
+  _Compiletime U64 discoverers(const Board<Set> &board)
+  {
+    U64 blockers = EMPTY;
+    U64 royal = board.royalty(!White);
+    Bitloop(royal)
+    {
+      const U16 offset = SquareOf(royal) << 6;
+      U64 sliders = (Lookup::xray<Rook>(SquareOf(royal), board.board.occ) & board.rooks(White, true)) |
+                    (Lookup::xray<Bishop>(SquareOf(royal), board.board.occ) & board.bishops(White, true));
+      Bitloop(sliders) blockers |= Lookup::PinBetween[offset + SquareOf(sliders)] & ~_blsi_u64(sliders);
+    }
+    return blockers & board.bitBoard(White, NoType);
+  }
+
+  // pieceMoves with the destinations narrowed down to what the generation mode asks for
+  template <U8 Set, bool White, PieceType Type, bool Check, GenMode Mode>
+  _Compiletime void modePieceMoves(MoveList<> &moves, const Board<Set> &board, const TimelineInfo &info, U64 pieces, const U64 &movable, const U64 &enemy, const U64 &pin, const U64 &discover, const TMask &tMask, const TimeAttacks &time)
+  {
+    if (Mode == GenCaptures)
+    {
+      pieceMoves<Type, Check, Mode>(moves, info, pieces, movable & enemy, board.board.occ, enemy, pin, tMask);
+    }
+    else if (Mode == GenQuietChecks)
+    {
+      const U64 quiet = movable & ~enemy;
+      pieceMoves<Type, Check, Mode>(moves, info, pieces & ~discover, quiet & (checkSquares<Set, White, Type>(board) | timeCheckSquares<Type>(time)), board.board.occ, enemy, pin, tMask);
+      pieceMoves<Type, Check, Mode>(moves, info, pieces & discover, quiet, board.board.occ, enemy, pin, tMask);
+    }
+    else
+    {
+      pieceMoves<Type, Check, Mode>(moves, info, pieces, movable, board.board.occ, enemy, pin, tMask);
+    }
+  }
+
+  template <U8 Size, U8 Set, U16 L, U16 T, bool White, bool Check, GenMode Mode>
+  _Compiletime void genAllMoves(MoveList<> &moves, const Board<Set> (&boards)[L + 16][T + 32], const Board<Set> &board, const TimelineInfo &info, const U64 &legalMask, const U64 &pastCheckMask, const TMask &tMask, const TimeAttacks &time)
   {
     constexpr U64 mask = Size == 1 ? 0x0000000000000001 : Size == 2 ? 0x0000000000000303
                                                       : Size == 3   ? 0x0000000000070707
@@ -364,6 +637,7 @@ namespace Chess5D
                                                       : Size == 6   ? 0x00003f3f3f3f3f3f
                                                       : Size == 7   ? 0x007f7f7f7f7f7f7f
                                                                     : FULL;
+    countTraffic(1, 0);
 
     const U64 pin = info.pinHV | info.pinD12;
     const U64 notPin = ~pin;
@@ -374,38 +648,41 @@ namespace Chess5D
     const U64 enemy = board.bitBoard(!White, NoType);
     const U64 movable = enemyOrEmpty & legalMask & mask;
     const U64 royalMovable = enemyOrEmpty & board.banMask & pastCheckMask & mask;
+    const U64 discover = Mode == GenQuietChecks ? discoverers<Set, White>(board) : EMPTY;
 
     // Pawns and brawns
     if (Set > WPawn)
-      board.template genPawnMoves<Size, White, Check>(moves, info, legalMask, notPin, notPinHV, notPinD12, tMask);
+      board.template genPawnMoves<Size, White, Check, Mode>(moves, info, legalMask, notPin, notPinHV, notPinD12, tMask, timeCheckSquares<(Set > WBrawn ? Brawn : Pawn)>(time), discover);
 
     // All regular pieces
     if (Set > WKnight)
+      modePieceMoves<Set, White, Knight, Check, Mode>(moves, board, info, board.bitBoard(White, Knight) & notPin, movable, enemy, pin, discover, tMask, time);
+    if (Set > WKnight && Mode == GenAll)
     {
-      pieceMoves<Knight, Check>(moves, info, board.bitBoard(White, Knight) & notPin, movable, board.board.occ, enemy, pin, tMask);
       U512 knightAttack = U512Set1(board.bitBoard(White, Knight) & notPin);
 
-      Board<Set> knightBoards[8] = {
-          boards[info.timeline + 1][info.turn + 4],
-          boards[info.timeline + 2][info.turn + 2],
-          boards[info.timeline + 2][info.turn - 2],
-          boards[info.timeline + 1][info.turn - 4],
-          boards[info.timeline - 1][info.turn - 4],
-          boards[info.timeline - 2][info.turn - 2],
-          boards[info.timeline - 2][info.turn + 2],
-          boards[info.timeline - 1][info.turn + 4],
+      const Board<Set> *knightBoards[8] = {
+          &boards[info.timeline + 1][info.turn + 4],
+          &boards[info.timeline + 2][info.turn + 2],
+          &boards[info.timeline + 2][info.turn - 2],
+          &boards[info.timeline + 1][info.turn - 4],
+          &boards[info.timeline - 1][info.turn - 4],
+          &boards[info.timeline - 2][info.turn - 2],
+          &boards[info.timeline - 2][info.turn + 2],
+          &boards[info.timeline - 1][info.turn + 4],
       };
+      countTraffic(8, 4);
 
-      U512 movable = U512Set(knightBoards[0].checkMask, knightBoards[1].checkMask, knightBoards[2].checkMask, knightBoards[3].checkMask,
-                             knightBoards[4].checkMask, knightBoards[5].checkMask, knightBoards[6].checkMask, knightBoards[7].checkMask) &
-                     ~U512Set(knightBoards[0].bitBoard(White, NoType),knightBoards[1].bitBoard(White, NoType),knightBoards[2].bitBoard(White, NoType),knightBoards[3].bitBoard(White, NoType),
-                           knightBoards[4].bitBoard(White, NoType),knightBoards[5].bitBoard(White, NoType),knightBoards[6].bitBoard(White, NoType),knightBoards[7].bitBoard(White, NoType));
+      U512 movable = U512Set(knightBoards[0]->checkMask, knightBoards[1]->checkMask, knightBoards[2]->checkMask, knightBoards[3]->checkMask,
+                             knightBoards[4]->checkMask, knightBoards[5]->checkMask, knightBoards[6]->checkMask, knightBoards[7]->checkMask) &
+                     ~U512Set(knightBoards[0]->bitBoard(White, NoType),knightBoards[1]->bitBoard(White, NoType),knightBoards[2]->bitBoard(White, NoType),knightBoards[3]->bitBoard(White, NoType),
+                           knightBoards[4]->bitBoard(White, NoType),knightBoards[5]->bitBoard(White, NoType),knightBoards[6]->bitBoard(White, NoType),knightBoards[7]->bitBoard(White, NoType));
 
-      U512 notOcc = ~U512Set(knightBoards[0].board.occ, knightBoards[1].board.occ, knightBoards[2].board.occ, knightBoards[3].board.occ,
-                             knightBoards[4].board.occ, knightBoards[5].board.occ, knightBoards[6].board.occ, knightBoards[7].board.occ);
+      U512 notOcc = ~U512Set(knightBoards[0]->board.occ, knightBoards[1]->board.occ, knightBoards[2]->board.occ, knightBoards[3]->board.occ,
+                             knightBoards[4]->board.occ, knightBoards[5]->board.occ, knightBoards[6]->board.occ, knightBoards[7]->board.occ);
 
-      U512 enemy = U512Set(knightBoards[0].bitBoard(!White, NoType),knightBoards[1].bitBoard(!White, NoType),knightBoards[2].bitBoard(!White, NoType),knightBoards[3].bitBoard(!White, NoType),
-                           knightBoards[4].bitBoard(!White, NoType),knightBoards[5].bitBoard(!White, NoType),knightBoards[6].bitBoard(!White, NoType),knightBoards[7].bitBoard(!White, NoType));
+      U512 enemy = U512Set(knightBoards[0]->bitBoard(!White, NoType),knightBoards[1]->bitBoard(!White, NoType),knightBoards[2]->bitBoard(!White, NoType),knightBoards[3]->bitBoard(!White, NoType),
+                           knightBoards[4]->bitBoard(!White, NoType),knightBoards[5]->bitBoard(!White, NoType),knightBoards[6]->bitBoard(!White, NoType),knightBoards[7]->bitBoard(!White, NoType));
 
       U512 legal = knightAttack & movable;
       U512 move = legal & notOcc;
@@ -422,21 +699,21 @@ namespace Chess5D
     }
     // LT only moves
     if (Set > WBishop)
-      pieceMoves<Bishop, Check>(moves, info, board.bitBoard(White, Bishop) & notPinHV & info.doublePin, movable, board.board.occ, enemy, pin, tMask);
+      modePieceMoves<Set, White, Bishop, Check, Mode>(moves, board, info, board.bitBoard(White, Bishop) & notPinHV & info.doublePin, movable, enemy, pin, discover, tMask, time);
     if (Set > WRook)
-      pieceMoves<Rook, Check>(moves, info, board.bitBoard(White, Rook) & notPinD12 & info.doublePin, movable, board.board.occ, enemy, pin, tMask);
+      modePieceMoves<Set, White, Rook, Check, Mode>(moves, board, info, board.bitBoard(White, Rook) & notPinD12 & info.doublePin, movable, enemy, pin, discover, tMask, time);
     if (Set > WQueen)
-      pieceMoves<Queen, Check>(moves, info, board.bitBoard(White, Queen) & info.doublePin, movable, board.board.occ, enemy, pin, tMask);
+      modePieceMoves<Set, White, Queen, Check, Mode>(moves, board, info, board.bitBoard(White, Queen) & info.doublePin, movable, enemy, pin, discover, tMask, time);
     if (Set > WKing)
-      pieceMoves<King, Check>(moves, info, board.bitBoard(White, King), royalMovable, board.board.occ, enemy, 0, tMask);
+      modePieceMoves<Set, White, King, Check, Mode>(moves, board, info, board.bitBoard(White, King), royalMovable, enemy, 0, discover, tMask, time);
     if (Set > WPrincess)
-      pieceMoves<Princess, Check>(moves, info, board.bitBoard(White, Princess) & info.doublePin, movable, board.board.occ, enemy, pin, tMask);
+      modePieceMoves<Set, White, Princess, Check, Mode>(moves, board, info, board.bitBoard(White, Princess) & info.doublePin, movable, enemy, pin, discover, tMask, time);
     if (Set > WCKing)
-      pieceMoves<CKing, Check>(moves, info, board.bitBoard(White, CKing) & info.doublePin, movable, board.board.occ, enemy, pin, tMask);
+      modePieceMoves<Set, White, CKing, Check, Mode>(moves, board, info, board.bitBoard(White, CKing) & info.doublePin, movable, enemy, pin, discover, tMask, time);
     if (Set > WRQueen)
-      pieceMoves<RQueen, Check>(moves, info, board.bitBoard(White, RQueen), royalMovable, board.board.occ, enemy, 0, tMask);
+      modePieceMoves<Set, White, RQueen, Check, Mode>(moves, board, info, board.bitBoard(White, RQueen), royalMovable, enemy, 0, discover, tMask, time);
 
-    if (!Check) // cant castle or travel when in check (except for royal queens)
+    if (!Check && Mode == GenAll) // cant castle or travel when in check (except for royal queens)
     {
       if (Set > WUnicorn)
         pieceMoves<Unicorn, Check>(moves, info, board.bitBoard(White, Unicorn) & notPin, movable, board.board.occ, enemy, pin, tMask);
@@ -454,17 +731,17 @@ namespace Chess5D
       genInfMoves<Size, Set, L, T, White, (Set > WRQueen), SouthEast>(moves, boards, board, info, diag);
       genInfMoves<Size, Set, L, T, White, (Set > WRQueen), South>(moves, boards, board, info, orth);
       genInfMoves<Size, Set, L, T, White, (Set > WRQueen), SouthWest>(moves, boards, board, info, diag);
+    }
 
-      // Castling
-      if (Set > WKing)
-      {
-        board.template genCastle<Size, White>(moves, info, board.banMask);
-      }
+    // Castling
+    if (!Check && (Mode == GenAll || Mode == GenSpatial) && Set > WKing)
+    {
+      board.template genCastle<Size, White>(moves, info, board.banMask);
     }
   }
 
-  template <U8 Size, U8 Set, U16 L, U16 T, bool White>
-  _Compiletime void genRoyalMoves(std::vector<Move> &moves, Board<Set> (&boards)[L + 16][T + 32], Board<Set> board, const TimelineInfo &info, const U64 &pastCheckMask, const TMask &tMask)
+  template <U8 Size, U8 Set, U16 L, U16 T, bool White, GenMode Mode>
+  _Compiletime void genRoyalMoves(MoveList<> &moves, const Board<Set> (&boards)[L + 16][T + 32], const Board<Set> &board, const TimelineInfo &info, const U64 &pastCheckMask, const TMask &tMask, const TimeAttacks &time)
   {
     constexpr U64 mask = Size == 1 ? 0x0000000000000001 : Size == 2 ? 0x0000000000000303
                                                       : Size == 3   ? 0x0000000000070707
@@ -473,46 +750,48 @@ namespace Chess5D
                                                       : Size == 6   ? 0x00003f3f3f3f3f3f
                                                       : Size == 7   ? 0x007f7f7f7f7f7f7f
                                                                     : FULL;
+    countTraffic(1, 0);
 
     const U64 royalMovable = ~board.bitBoard(White, NoType) & board.banMask & pastCheckMask & mask;
     const U64 enemy = board.bitBoard(!White, NoType);
     if (Set > WKing)
-      pieceMoves<King, false>(moves, info, board.bitBoard(White, King), royalMovable, board.board.occ, enemy, 0, tMask);
+      modePieceMoves<Set, White, King, false, Mode>(moves, board, info, board.bitBoard(White, King), royalMovable, enemy, 0, EMPTY, tMask, time);
     if (Set > WRQueen)
-      pieceMoves<RQueen, false>(moves, info, board.bitBoard(White, RQueen), royalMovable, board.board.occ, enemy, 0, tMask);
+      modePieceMoves<Set, White, RQueen, false, Mode>(moves, board, info, board.bitBoard(White, RQueen), royalMovable, enemy, 0, EMPTY, tMask, time);
   }
 
   template <U8 Set, U8 Size, U16 L, U16 T>
-  template <bool White>
-  _Compiletime void Chess<Set, Size, L, T>::generateMoves(std::vector<Move> &moves, U16 timeline)
+  template <bool White, GenMode Mode>
+  _Compiletime void Chess<Set, Size, L, T>::generateMoves(MoveList<> &moves, U16 timeline, const TimeAttacks &time)
   {
     // Get the board and set up checkMasks, pinMasks, and banMask
     TimelineInfo info = timelineInfo[timeline];
     Board<Set> &brd = boards[timeline][info.turn]; // eventually needs to be done for every timeline or specify timeline in input
 
-    if(brd.pastCheck==FULL) createMask<Set, T, White>(&brd); //Past Checks Generate if not done already
+    updatePastCheck<White>(timeline); // Past Checks Generate if not done already
 
     const U64 pastCheckMask = brd.pastCheck | -(brd.pastCheck == 0);
     const U64 legalMask = brd.checkMask & pastCheckMask;
 
     if (brd.pastCheck == EMPTY)
     {
-      TMask tmask = travelMasks<Set, L, T, White>(boards, timeline, info.turn); // generate travels masks
+      // only read when generating travels
+      const TMask &tmask = Mode == GenAll ? travelMaskCache<White>(timeline) : maskCache[timeline].tMask;
 
       if (legalMask == FULL)
       {
-        genAllMoves<Size, Set, L, T, White, false>(moves, boards, brd, info, legalMask, pastCheckMask, tmask);
+        genAllMoves<Size, Set, L, T, White, false, Mode>(moves, boards, brd, info, legalMask, pastCheckMask, tmask, time);
       }
       else if (legalMask)
       {
-        genAllMoves<Size, Set, L, T, White, true>(moves, boards, brd, info, legalMask, pastCheckMask, tmask);
+        genAllMoves<Size, Set, L, T, White, true, Mode>(moves, boards, brd, info, legalMask, pastCheckMask, tmask, time);
       }
-      else
+      else if (Mode != GenQuietChecks)
       {
-        genRoyalMoves<Size, Set, L, T, White>(moves, boards, brd, info, pastCheckMask, tmask);
+        genRoyalMoves<Size, Set, L, T, White, Mode>(moves, boards, brd, info, pastCheckMask, tmask, time);
       }
     }
-    else if ((brd.pastCheck & (brd.pastCheck - 1)) == EMPTY)
+    else if (Mode != GenQuietChecks && (brd.pastCheck & (brd.pastCheck - 1)) == EMPTY)
     {
       if (legalMask)
         brd.template genBitMoves<Size, White>(moves, info, legalMask, pastCheckMask);
@@ -521,6 +800,190 @@ namespace Chess5D
     }
   }
 
+  // Returns the lowest active timeline at or above `from` whose headboard belongs to the given side, or -1 if none remain.
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  template <bool White>
+  _Compiletime int Chess<Set, Size, L, T>::playableTimeline(int from) const
+  {
+    for (int i = std::max(from, origIndex[1] - activeNum[1]); i <= origIndex[0] + activeNum[0]; ++i)
+    {
+      if ((timelineInfo[i].turn & 1) == (White ? 0 : 1))
+        return i;
+    }
+    return -1;
+  }
+
+  // A board's contribution to the multiverse hash. Boards that exist never have every square occupied.
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  _Compiletime U64 Chess<Set, Size, L, T>::boardKey(U16 timeline, U8 turn) const
+  {
+    const Board<Set> &brd = boards[timeline][turn];
+    return Zobrist::place(brd.board.hash ^ brd.epKey(), zobrist.timeline[timeline] ^ zobrist.turn[turn]);
+  }
+
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  _Compiletime U64 Chess<Set, Size, L, T>::fullHash() const
+  {
+    U64 key = 0;
+    for (U16 i = 0; i < L + 16; ++i)
+      for (U16 j = 0; j < T + 32; ++j)
+        if (boards[i][j].board.occ != FULL)
+          key ^= boardKey(i, j);
+    return key;
+  }
+
+  // Records a write to boards[timeline][turn], invalidating the cached masks of nearby headboards
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  _Compiletime void Chess<Set, Size, L, T>::touch(U16 timeline, U8 turn)
+  {
+    changed[timeline][turn & 1] = ++changes;
+  }
+
+  // Whether a board of one of the turn `parities` (bit 0 even, bit 1 odd) on a timeline at most `radius` away from
+  // `timeline` was written after `stamp`
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  _Compiletime bool Chess<Set, Size, L, T>::changedSince(U16 timeline, U8 radius, U64 stamp, U8 parities) const
+  {
+    const int last = std::min(timeline + radius, L + 15);
+    for (int i = std::max(timeline - radius, 0); i <= last; ++i)
+    {
+      if (((parities & 1) && changed[i][0] > stamp) || ((parities & 2) && changed[i][1] > stamp))
+        return true;
+    }
+    return false;
+  }
+
+  // The time attacks of createMask reach boards of both parities up to 8 timelines away
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  template <bool White>
+  _Compiletime void Chess<Set, Size, L, T>::updatePastCheck(U16 timeline)
+  {
+    const U8 turn = timelineInfo[timeline].turn;
+    Board<Set> &brd = boards[timeline][turn];
+    MaskCache &cache = maskCache[timeline];
+    if (brd.pastCheck == FULL || cache.pastTurn != turn || changedSince(timeline, 8, cache.pastStamp, 3))
+    {
+      createMask<Set, T, White>(&brd);
+      cache.pastTurn = turn;
+      cache.pastStamp = changes;
+    }
+  }
+
+  // travelMasks only reads boards of the headboard's parity up to 7 timelines away. Moves of the side to move write
+  // boards of the other parity, so every generation at one node and its moves on other timelines share the masks. A reply
+  // on the same timeline writes the headboard's parity again, after which they are rebuilt.
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  template <bool White>
+  _Compiletime const TMask &Chess<Set, Size, L, T>::travelMaskCache(U16 timeline)
+  {
+    const U8 turn = timelineInfo[timeline].turn;
+    MaskCache &cache = maskCache[timeline];
+    if (cache.tMaskStamp == 0 || cache.tMaskTurn != turn || changedSince(timeline, 7, cache.tMaskStamp, 1 << (turn & 1)))
+    {
+      cache.tMask = travelMasks<Set, L, T, White>(boards, timeline, turn);
+      cache.tMaskTurn = turn;
+      cache.tMaskStamp = changes;
+    }
+    return cache.tMask;
+  }
+
+  // The time attacks are those of the board a move from the headboard of `timeline` lands on, filled in before it exists
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  template <bool White>
+  _Compiletime CheckInfo Chess<Set, Size, L, T>::checkInfo(U16 timeline) const
+  {
+    const Board<Set> *brd = &boards[timeline][timelineInfo[timeline].turn];
+    decltype(Board<Set>::pastMask) pastMask;
+    fillPastMask<Set, !White>(brd + 1, pastMask);
+
+    CheckInfo info;
+    info.royal = brd->royalty(!White);
+    info.time = timeAttacks<Set, T, !White>(brd + 1, pastMask);
+    info.timeCheckers = timeCheckers<Set, !White>(brd, info.time);
+    return info;
+  }
+
+  // Whether `move` checks the opponent on the board it is made from, spatially or through time, or on the board a travel
+  // creates, without making it
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  template <bool White>
+  _Compiletime bool Chess<Set, Size, L, T>::givesCheck(const Move &move, const CheckInfo &info) const
+  {
+    const Board<Set> &brd = boards[move.sTimeline][move.sTurn];
+    const bool promotion = move.type == Promotion || move.type == PromoCapture || move.type >= TravelPromotion;
+    const PieceType type = PieceType((promotion ? move.special1 : brd.board.mailboxBoard[move.from]) >> 1);
+    const U64 from = 1ull << move.from;
+    const U64 to = 1ull << move.to;
+
+    if (move.type == Castle)
+    {
+      const U64 rookFrom = 1ull << move.special1;
+      const U64 occ = brd.board.occ ^ from ^ rookFrom | to | 1ull << move.special2;
+      return (info.timeCheckers & ~(from | rookFrom)) || timeAttack(info.time, Rook, move.special2) ||
+             spatialCheck<Set, White>(brd, info.royal, occ, from | rookFrom, pieceAttacks<Set, White>(Rook, move.special2, occ));
+    }
+
+    // Pieces that already attack through time keep doing so from the new board
+    if (info.timeCheckers & ~from)
+      return true;
+
+    if (move.type < Travel)
+    {
+      const U64 captured = move.type == Enpassant ? 1ull << move.special1 : EMPTY;
+      const U64 occ = (brd.board.occ ^ from ^ captured) | to;
+      return timeAttack(info.time, type, move.to) || spatialCheck<Set, White>(brd, info.royal, occ, from, pieceAttacks<Set, White>(type, move.to, occ));
+    }
+
+    // Discovered on the board left behind, or given by the piece on the board it arrives at
+    const Board<Set> &dst = boards[move.eTimeline][move.eTurn];
+    const U64 occ = dst.board.occ | to;
+    if (spatialCheck<Set, White>(brd, info.royal, brd.board.occ ^ from, from, EMPTY) ||
+        spatialCheck<Set, White>(dst, dst.royalty(!White), occ, EMPTY, pieceAttacks<Set, White>(type, move.to, occ)))
+      return true;
+
+    // Through time from the board the travel creates, on top of the destination timeline or on the timeline it branches off
+    const U16 arrival = timelineInfo[move.eTimeline].turn == move.eTurn ? move.eTimeline : origIndex[White] + (White ? -1 : 1) * (timelineNum[White] + 1);
+    const Board<Set> *created = &boards[arrival][move.eTurn + 1];
+    decltype(Board<Set>::pastMask) pastMask;
+    fillPastMask<Set, !White>(created, pastMask);
+    const TimeAttacks time = timeAttacks<Set, T, !White>(created, pastMask);
+    return timeAttack(time, type, move.to) || timeCheckers<Set, !White>(&dst, time);
+  }
+
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  template <bool White>
+  _Compiletime bool Chess<Set, Size, L, T>::givesCheck(const Move &move) const
+  {
+    return givesCheck<White>(move, checkInfo<White>(move.sTimeline));
+  }
+
+#ifdef HASH_CHECK
+  // Built with `hashcheck`, every board a move creates has its incremental hash and sums compared with a full recompute
+  template <U8 Set>
+  void checkHash(const Board<Set> &brd)
+  {
+    if (brd.board.hash != brd.fullHash())
+    {
+      std::cerr << "Incremental hash mismatch" << std::endl;
+      std::abort();
+    }
+    if (brd.board.sums != brd.fullSum())
+    {
+      std::cerr << "Incremental evaluation sums mismatch" << std::endl;
+      std::abort();
+    }
+#ifdef NNUE
+    HiddenLayer hidden;
+    network.refresh(hidden, brd.board.mailboxBoard);
+    if (std::memcmp(&hidden, &brd.board.hidden, sizeof(hidden)) != 0)
+    {
+      std::cerr << "Incremental network layer mismatch" << std::endl;
+      std::abort();
+    }
+#endif
+  }
+#endif
+
   template <U8 Set, U8 Size, U16 L, U16 T>
   template <bool White>
   _Compiletime void Chess<Set, Size, L, T>::makeMove(const Move &move)
@@ -590,12 +1053,18 @@ namespace Chess5D
       const Piece piece = promotion ? Piece(move.special1) : brd.board.mailboxBoard[move.from];
 
       const U64 from = 1ull << move.from;
+      brd.board.hash ^= brd.squaresKey(from);
+      brd.board.sums -= brd.squaresSum(from);
+      brd.template updateHidden<-1>(from);
       brd.board.bitBoard[brd.board.mailboxBoard[move.from]] ^= from;
       brd.template bitBoard<White, NoType>() ^= from;
       brd.board.occ ^= from;
       brd.board.unmoved &= ~from;
       brd.board.epTarget = 0;
       brd.board.mailboxBoard[move.from] = NoPiece;
+      brd.board.hash ^= brd.squaresKey(from);
+      brd.board.sums += brd.squaresSum(from);
+      brd.template updateHidden<1>(from);
 
       if (move.type == TravelCapture || move.type == TravelPromoCapture)
       {
@@ -608,11 +1077,21 @@ namespace Chess5D
 
       brdTravel.template refresh<!White>(timelineInfo[newTimeline]);
       refreshMask<Set, !White>(&brdTravel);
+      touch(newTimeline, move.eTurn + 1);
+      hash ^= boardKey(newTimeline, move.eTurn + 1);
+#ifdef HASH_CHECK
+      checkHash(brdTravel);
+#endif
     }
     ++timelineInfo[move.sTimeline].turn;
+    touch(move.sTimeline, move.sTurn + 1);
 
     brd.template refresh<!White>(timelineInfo[move.sTimeline]);
     refreshMask<Set, !White>(&brd);
+    hash ^= boardKey(move.sTimeline, move.sTurn + 1); // After refresh, which may drop an en passant target
+#ifdef HASH_CHECK
+    checkHash(brd);
+#endif
 
     //Update Present TODO: Currently does calculation multiple times over
     for (int i = origIndex[1] - activeNum[1]; i <= origIndex[0] + activeNum[0]; ++i)
@@ -627,6 +1106,7 @@ namespace Chess5D
   _Compiletime void Chess<Set, Size, L, T>::undoMove(const Move &move)
   { // if board saves the timeline it creates you could pass only a timeline index to it
     Board<Set> &brd = boards[move.sTimeline][move.sTurn + 1];
+    hash ^= boardKey(move.sTimeline, move.sTurn + 1);
     brd.board.occ = FULL;
     brd.checkMask = EMPTY;
     if (Set > WKing)
@@ -661,6 +1141,7 @@ namespace Chess5D
       }
 
       Board<Set> &brdTo = boards[eTimelineReal][move.eTurn + 1];
+      hash ^= boardKey(eTimelineReal, move.eTurn + 1);
       brdTo.board.occ = FULL;
       brdTo.checkMask = EMPTY;
       if (Set > WKing)
@@ -678,7 +1159,7 @@ namespace Chess5D
       brdTo.pastMask.southeast = EMPTY;
       brdTo.pastMask.southwest = EMPTY;
       brdTo.pastMask.northwest = EMPTY;
-      brdTo.pastCheck=FULL;
+      touch(eTimelineReal, move.eTurn + 1);
     }
 
     brd.pastMask.center = EMPTY;
@@ -690,7 +1171,7 @@ namespace Chess5D
     brd.pastMask.southeast = EMPTY;
     brd.pastMask.southwest = EMPTY;
     brd.pastMask.northwest = EMPTY;
-    brd.pastCheck=FULL;
+    touch(move.sTimeline, move.sTurn + 1);
 
     //Update Present TODO: Currently does calculation multiple times over
     for (int i = origIndex[1] - activeNum[1]; i <= origIndex[0] + activeNum[0]; ++i)
@@ -842,6 +1323,8 @@ namespace Chess5D
         timelineNum[0] = brdL - origIndex[0];
 
       Board<Set> &brd = boards[brdL][brdT];
+      if (brd.board.occ != FULL) // Imported again, its key is added back below
+        hash ^= boardKey(brdL, brdT);
       for (U8 i = 0; i < Size; ++i)
       {
         const std::string &row = board[i + 1].str();
@@ -868,11 +1351,15 @@ namespace Chess5D
       for (U8 p = BPawn; p < Set; p += 2)
         brd.board.black |= brd.board.bitBoard[p];
       brd.board.occ = brd.board.white | brd.board.black;
+      brd.board.hash = brd.fullHash();
+      brd.board.sums = brd.fullSum();
+      brd.refreshHidden();
 
       TimelineInfo &info = timelineInfo[brdL];
       info.turn = info.turn == 0 ? brdT : std::min(info.turn, brdT);
       info.tailIndex = std::max(info.tailIndex, brdT);
 
+      touch(brdL, brdT);
       if (white)
       {
         brd.template refresh<true>(info); // refresh
@@ -883,6 +1370,7 @@ namespace Chess5D
         brd.template refresh<false>(info);
         refreshMask<Set, false>(&brd);
       }
+      hash ^= boardKey(brdL, brdT);
     }
     activeNum[1] = std::min((int)timelineNum[1], timelineNum[0] + 1);
     activeNum[0] = std::min(timelineNum[1]+1, (int)timelineNum[0]);
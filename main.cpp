@@ -2,50 +2,48 @@
 #include "ai.hpp"
 #include "positions.hpp"
 
+// Prints the principal variation from moveset `ply` on, playing it on `chess` and taking it back
 template <U8 Set, U8 Size, U16 L, U16 T, bool White>
-void backtrace(Chess<Set, Size, L, T> &chess, int timeline, int depth)
+void printPV(Chess<Set, Size, L, T> &chess, const Chess5D::PVLine &pv, int ply = 0, int offset = 0)
 {
-    TimelineInfo info = chess.timelineInfo[timeline];
-    Board<Set> &brd = chess.boards[timeline][info.turn];
+    if (ply == pv.plies)
+        return;
+    const Move *moveset = pv.moves + offset;
+    const int size = pv.sizes[ply];
 
-    U64 key = tt.computeHashKey<Set, White>(brd);
-    TTEntry &ttEntry = tt.probe(key);
-
-    if (ttEntry.key == key)
+    if (!White)
     {
-        if(ttEntry.isQSearch) std::cout << "invalid\n";
-        Move move = ttEntry.move;
-        if (!White)
+        if (ply == 0)
         {
-            if (depth == 0)
-            {
-                std::cout << "1. ... ";
-            }
-            std::cout << "/" << chess.template moveToPGN<false>(move) << " {" << move.score << "}" << std::endl;
-        }
-        else
-        {
-            std::cout << depth / 2 + 1 + (depth) % 2 << ". " << chess.template moveToPGN<true>(move) << " {" << move.score << "}";
+            std::cout << "1. ... ";
         }
+        std::cout << "/";
+    }
+    else
+    {
+        std::cout << ply / 2 + 1 + (ply) % 2 << ". ";
+    }
+    for (int i = 0; i < size; ++i)
+    {
+        std::cout << (i ? " " : "") << chess.template moveToPGN<White>(moveset[i]);
+        chess.template makeMove<White>(moveset[i]);
+    }
+    std::cout << (White ? " " : "\n");
 
-        chess.template makeMove<White>(move);
-        if (move.type >= Travel)
-        {
-            U8 newTimeline = chess.origIndex[White] + (White ? -1 : 1) * (chess.timelineNum[White]);
-            backtrace<Set, Size, L, T, !White>(chess, newTimeline, depth + 1);
-        }
-        else
-        {
-            backtrace<Set, Size, L, T, !White>(chess, timeline, depth + 1);
-        }
-        chess.template undoMove<White>(move);
+    printPV<Set, Size, L, T, !White>(chess, pv, ply + 1, offset + size);
+
+    for (int i = 0; i < size; ++i)
+    {
+        chess.template undoMove<White>(moveset[i]);
     }
-    return;
 }
+
+// `threads` and `mode` are handed to every search, see negaMaxIDDFS
 template <U8 Set, U8 Size, U16 L, U16 T>
-void playChess()
+void playChess(int threads, Chess5D::ParallelMode mode)
 {
     Chess5D::Chess<Set, Size, L, T> chess{};
+    Chess5D::SearchContext ctx(tt);
 
     // Prompt user for FEN input or predefined position
     std::cout << "Enter FEN string or a number to load a predefined position: ";
@@ -88,7 +86,7 @@ void playChess()
         }
         else if (option == "engine")
         {
-            Chess5D::killerTable.empty();
+            ctx.clearOrdering();
             // Prompt user for depth
             int depth;
             std::cout << "Enter depth: ";
@@ -100,51 +98,22 @@ void playChess()
             std::getline(std::cin, color);
             bool isBlack = (color == "b");
 
-            count = 0;
-            hitCount = 0;
-            collision = 0;
+            ctx.resetStats();
+            const Chess5D::SearchLimits limits{depth, std::chrono::milliseconds(10000), std::chrono::milliseconds(20000)};
             auto begin = std::chrono::high_resolution_clock::now();
             // Chess5D::Result res = isBlack ? negaMax<Set, Size, L, T, false>(chess, -CHECKMATE, CHECKMATE, depth, std::vector<Chess5D::Move>()) : negaMax<Set, Size, L, T, true>(chess, -CHECKMATE, CHECKMATE, depth, std::vector<Chess5D::Move>());
-            Chess5D::Result res = isBlack ? negaMaxIDDFS<Set, Size, L, T, false>(chess, depth, std::chrono::milliseconds(20000)) : negaMaxIDDFS<Set, Size, L, T, true>(chess, depth, std::chrono::milliseconds(20000));
+            Chess5D::Result res = isBlack ? negaMaxIDDFS<Set, Size, L, T, false>(ctx, chess, limits, threads, mode) : negaMaxIDDFS<Set, Size, L, T, true>(ctx, chess, limits, threads, mode);
             auto end = std::chrono::high_resolution_clock::now();
             std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1000000000.0 << " s\n";
-            std::cout << "Positions: " << count << std::endl;
-            std::cout << "Hits: " << hitCount << std::endl;
-            std::cout << "Collision: " << collision << std::endl;
+            std::cout << "Positions: " << ctx.count << std::endl;
+            std::cout << "Hits: " << ctx.hitCount << std::endl;
+            std::cout << "Eval cache hits: " << ctx.evalHits << " (" << 100.0 * ctx.evalHits / std::max<U64>(ctx.count, 1) << "%)" << std::endl;
+            std::cout << "Collision: " << ctx.collision << std::endl;
             std::cout << chess << std::endl;
 
             std::cout << res.value << std::endl;
 
-            int timeline = chess.origIndex[!isBlack];
-
-            isBlack ? backtrace<Set, Size, L, T, false>(chess, timeline, 0) : backtrace<Set, Size, L, T, true>(chess, timeline, 0);
-            /*
-            std::cout << "Regular "<< std::endl;
-            int i = 0;
-            const Chess5D::Result *resPtr = &res;
-            while (resPtr != nullptr)
-            {
-                for (const auto &move : resPtr->moveset)
-                {
-                    if (isBlack)
-                    {
-                        if (i == 0)
-                        {
-                            std::cout << "1. ... ";
-                        }
-                        std::cout << "/" << chess.template moveToPGN<false>(move) << " {" << move.score << "}" << std::endl;
-                    }
-                    else
-                    {
-                        std::cout << i / 2 + 1 + (i) % 2 << ". " << chess.template moveToPGN<true>(move) << " {" << move.score << "}";
-                    }
-                    isBlack = !isBlack;
-                }
-                resPtr = resPtr->next.get();
-                i++;
-            }
-            */
-
+            isBlack ? printPV<Set, Size, L, T, false>(chess, res.pv) : printPV<Set, Size, L, T, true>(chess, res.pv);
             std::cout << std::endl;
         }
         else if (option == "test")
@@ -158,10 +127,16 @@ void playChess()
             std::string color;
             std::getline(std::cin, color);
             bool isBlack = (color == "b");
+            const Chess5D::SearchLimits limits{depth, std::chrono::milliseconds(5000), std::chrono::milliseconds(10000)};
 
             while (true)
             {
-                Chess5D::Result res = isBlack ? negaMaxIDDFS<Set, Size, L, T, false>(chess, depth, std::chrono::milliseconds(10000)) : negaMaxIDDFS<Set, Size, L, T, true>(chess, depth, std::chrono::milliseconds(10000));
+                Chess5D::Result res = isBlack ? negaMaxIDDFS<Set, Size, L, T, false>(ctx, chess, limits, threads, mode) : negaMaxIDDFS<Set, Size, L, T, true>(ctx, chess, limits, threads, mode);
+                if (res.moveset.empty()) // Mated, stalemated or out of time before the first iteration
+                {
+                    std::cout << "No move found, " << res.value << std::endl;
+                    break;
+                }
                 isBlack ? chess.template makeMove<false>(res.moveset[0]) : chess.template makeMove<true>(res.moveset[0]);
                 std::cout << res.value << std::endl;
                 std::cout << chess << std::endl;
@@ -183,7 +158,7 @@ void playChess()
             std::getline(std::cin, color);
             bool isBlack = (color == "b");
 
-            std::cout << (isBlack ? evaluate<Set, Size, L, T, false>(chess, chess.origIndex[0],0) : evaluate<Set, Size, L, T, true>(chess, chess.origIndex[0],0)) << std::endl;
+            std::cout << (isBlack ? evaluate<Set, Size, L, T, false>(ctx, chess, chess.origIndex[0],0) : evaluate<Set, Size, L, T, true>(ctx, chess, chess.origIndex[0],0)) << std::endl;
         }
         else if (option == "exit")
         {
@@ -196,8 +171,35 @@ void playChess()
     }
 }
 
-int main()
+// Usage: main [--tt snapshot] [--threads n] [--mode lazysmp|ybw] [network file]
+// The transposition table starts from the snapshot when there is one and is written back to it on exit.
+// Searches run on one thread unless told otherwise, a single timeline uses the threads as `mode` says.
+// The network is only used when built with NNUE.
+int main(int argc, char **argv)
 {
+    std::string snapshot, networkFile;
+    int threads = 1;
+    Chess5D::ParallelMode mode = Chess5D::ParallelLazySMP;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--tt" && i + 1 < argc)
+            snapshot = argv[++i];
+        else if (std::string(argv[i]) == "--threads" && i + 1 < argc)
+            threads = std::max(1, std::stoi(argv[++i]));
+        else if (std::string(argv[i]) == "--mode" && i + 1 < argc)
+            mode = std::string(argv[++i]) == "ybw" ? Chess5D::ParallelYBW : Chess5D::ParallelLazySMP;
+        else
+            networkFile = argv[i];
+    }
+
+#ifdef NNUE
+    // Loaded before any board is made, since new boards start from the network's first layer
+    if (!networkFile.empty() && !Chess5D::network.load(networkFile))
+        std::cout << "Could not load the network " << networkFile << ", using the hand-written evaluation" << std::endl;
+#endif
+    if (!snapshot.empty() && !Chess5D::tt.load(snapshot))
+        std::cout << "No usable table snapshot in " << snapshot << ", starting empty" << std::endl;
+
     // To allow unicode characters
 
     system("chcp 65001 > nul");
@@ -230,7 +232,9 @@ int main()
         std::cout << chess.template moveToPGN<White>(move) << std::endl;
     }
     */
-    playChess<Set, Size, L, T>();
+    playChess<Set, Size, L, T>(threads, mode);
 
+    if (!snapshot.empty() && !Chess5D::tt.save(snapshot))
+        std::cout << "Could not write the table snapshot " << snapshot << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "lookup.hpp"
+
+namespace Chess5D
+{
+  // Learned evaluation in the style of NNUE: a wide first layer over sparse inputs, whose output the boards keep up to
+  // date as pieces move, then a single quantized output layer. Boards only carry the first layer when built with NNUE.
+  static constexpr int NNUE_HIDDEN = 128;
+  static constexpr int NNUE_PIECE_INPUTS = NoPiece * 64; // Piece on square, see pieceFeature
+  static constexpr int NNUE_PAST_INPUTS = 64;             // Squares of the board's past mask
+  static constexpr int NNUE_TIMELINE_INPUTS = 7;          // White's lead in timelines, clamped to [-3, 3]
+  static constexpr int NNUE_INPUTS = NNUE_PIECE_INPUTS + NNUE_PAST_INPUTS + NNUE_TIMELINE_INPUTS;
+  static constexpr int NNUE_QA = 127;   // First layer outputs are clipped to [0, NNUE_QA]
+  static constexpr int NNUE_QB = 64;    // Output weights are scaled by this
+  static constexpr int NNUE_SCALE = 16; // Evaluation units per unit of network output
+  static constexpr uint32_t NNUE_MAGIC = 0x4E4E4435; // "5DNN"
+
+  // 32 lanes of 16 bits, a 512 bit vector like U512 that the compiler lowers to AVX-512, AVX2 or SSE
+  typedef int16_t I16x32 __attribute__((vector_size(64)));
+  typedef int32_t I32x32 __attribute__((vector_size(128)));
+  static constexpr int NNUE_LANES = NNUE_HIDDEN / 32;
+
+  struct HiddenLayer
+  {
+    I16x32 lanes[NNUE_LANES];
+  };
+
+  _Compiletime int pieceFeature(Piece piece, int sq) { return piece * 64 + sq; }
+
+  // Weights in the flat file, little endian and in this order after the magic number and the two sizes:
+  // int16 hiddenBias[NNUE_HIDDEN], int16 hiddenWeights[NNUE_INPUTS][NNUE_HIDDEN], int8 outputWeights[NNUE_HIDDEN],
+  // int32 outputBias. The output is White's score.
+  struct Network
+  {
+    HiddenLayer hiddenBias;
+    HiddenLayer hiddenWeights[NNUE_INPUTS];
+    I16x32 outputWeights[NNUE_LANES]; // Widened from int8, the products still fit 16 bits
+    int32_t outputBias = 0;
+    bool loaded = false;
+
+    // Returns false, leaving the network as it was, if the file is missing or was made for other sizes
+    bool load(const std::string &path)
+    {
+      std::ifstream file(path, std::ios::binary);
+      uint32_t header[3];
+      if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != NNUE_MAGIC ||
+          header[1] != NNUE_INPUTS || header[2] != NNUE_HIDDEN)
+        return false;
+
+      HiddenLayer bias;
+      std::vector<HiddenLayer> weights(NNUE_INPUTS);
+      int8_t output[NNUE_HIDDEN];
+      int32_t outBias;
+      file.read(reinterpret_cast<char *>(&bias), sizeof(bias));
+      file.read(reinterpret_cast<char *>(weights.data()), NNUE_INPUTS * sizeof(HiddenLayer));
+      file.read(reinterpret_cast<char *>(output), sizeof(output));
+      if (!file.read(reinterpret_cast<char *>(&outBias), sizeof(outBias)))
+        return false;
+
+      hiddenBias = bias;
+      std::copy(weights.begin(), weights.end(), hiddenWeights);
+      for (int i = 0; i < NNUE_HIDDEN; ++i)
+        outputWeights[i / 32][i % 32] = output[i];
+      outputBias = outBias;
+      loaded = true;
+      return true;
+    }
+
+    bool save(const std::string &path) const
+    {
+      std::ofstream file(path, std::ios::binary);
+      const uint32_t header[3] = {NNUE_MAGIC, NNUE_INPUTS, NNUE_HIDDEN};
+      int8_t output[NNUE_HIDDEN];
+      for (int i = 0; i < NNUE_HIDDEN; ++i)
+        output[i] = outputWeights[i / 32][i % 32];
+      file.write(reinterpret_cast<const char *>(header), sizeof(header));
+      file.write(reinterpret_cast<const char *>(&hiddenBias), sizeof(hiddenBias));
+      file.write(reinterpret_cast<const char *>(hiddenWeights), sizeof(hiddenWeights));
+      file.write(reinterpret_cast<const char *>(output), sizeof(output));
+      file.write(reinterpret_cast<const char *>(&outputBias), sizeof(outputBias));
+      return bool(file);
+    }
+
+    // Adds (Sign 1) or removes (Sign -1) an input's weights
+    template <int Sign>
+    _Compiletime void update(HiddenLayer &layer, int feature) const
+    {
+      for (int i = 0; i < NNUE_LANES; ++i)
+        layer.lanes[i] = Sign > 0 ? layer.lanes[i] + hiddenWeights[feature].lanes[i] : layer.lanes[i] - hiddenWeights[feature].lanes[i];
+    }
+
+    // The first layer over the pieces of a board, computed from scratch
+    _Compiletime void refresh(HiddenLayer &layer, const Piece (&mailbox)[64]) const
+    {
+      layer = hiddenBias;
+      for (int sq = 0; sq < 64; ++sq)
+        if (mailbox[sq] != NoPiece)
+          update<1>(layer, pieceFeature(mailbox[sq], sq));
+    }
+
+    // White's score, from a board's first layer and the inputs boards do not keep up to date
+    _Compiletime int evaluate(const HiddenLayer &pieces, U64 past, int timelineLead) const
+    {
+      HiddenLayer layer = pieces;
+      Bitloop(past) update<1>(layer, NNUE_PIECE_INPUTS + SquareOf(past));
+      update<1>(layer, NNUE_PIECE_INPUTS + NNUE_PAST_INPUTS + std::clamp(timelineLead, -3, 3) + 3);
+
+      const I16x32 zero{};
+      const I16x32 top = zero + NNUE_QA;
+      I32x32 sum{};
+      for (int i = 0; i < NNUE_LANES; ++i)
+      {
+        I16x32 clipped = layer.lanes[i] < zero ? zero : layer.lanes[i];
+        clipped = clipped > top ? top : clipped;
+        sum += __builtin_convertvector(clipped * outputWeights[i], I32x32);
+      }
+
+      int dot = outputBias;
+      for (int i = 0; i < 32; ++i)
+        dot += sum[i];
+      return dot * NNUE_SCALE / (NNUE_QA * NNUE_QB);
+    }
+  };
+
+  inline Network network;
+};
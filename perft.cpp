@@ -0,0 +1,79 @@
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include "perft.hpp"
+#include "positions.hpp"
+
+using namespace Chess5D;
+
+static constexpr int NUM_POSITIONS = 12;
+
+// Heap allocations made while counting, move generation itself should not allocate at all
+static U64 allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    ++allocations;
+    if (void *ptr = std::malloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+template <U8 Set, U8 Size, U16 L, U16 T>
+U64 runPerft(Chess<Set, Size, L, T> &chess, int depth, bool split)
+{
+    const bool white = whiteToMove(chess);
+    if (split)
+        return white ? divide<Set, Size, L, T, true>(chess, depth) : divide<Set, Size, L, T, false>(chess, depth);
+    return white ? perft<Set, Size, L, T, true>(chess, depth) : perft<Set, Size, L, T, false>(chess, depth);
+}
+
+// Usage: perft [depth] [position]
+// Without a position every predefined position is counted, with one the node count is divided per root move.
+// Movesets grow as the product of every timeline's moves, so the summary counts multi-timeline positions at depth 1.
+int main(int argc, char **argv)
+{
+    constexpr U8 Set = Chess5D::NoPiece;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    const int depth = argc > 1 ? std::stoi(argv[1]) : 2;
+    const int first = argc > 2 ? std::stoi(argv[2]) : 0;
+    const int last = argc > 2 ? first : NUM_POSITIONS - 1;
+
+    U64 totalNodes = 0;
+    double totalTime = 0;
+    for (int pos = first; pos <= last; ++pos)
+    {
+        // Too large for the default stack
+        auto chess = std::make_unique<Chess<Set, Size, L, T>>();
+        Positions::load(*chess, pos);
+
+        const bool multiverse = chess->timelineNum[0] + chess->timelineNum[1] > 0;
+        const int posDepth = argc > 2 || !multiverse ? depth : std::min(depth, 1);
+
+        allocations = 0;
+        auto begin = std::chrono::high_resolution_clock::now();
+        const U64 nodes = runPerft(*chess, posDepth, argc > 2);
+        auto end = std::chrono::high_resolution_clock::now();
+        const U64 nodeAllocations = allocations;
+
+        const double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1000000000.0;
+        totalNodes += nodes;
+        totalTime += seconds;
+
+        std::cout << "Position " << pos << " depth " << posDepth << ": " << nodes << " nodes, "
+                  << seconds << " s, " << U64(nodes / std::max(seconds, 1e-9)) << " nodes/s, "
+                  << double(nodeAllocations) / std::max(nodes, U64(1)) << " allocs/node" << std::endl;
+    }
+
+    std::cout << "Total: " << totalNodes << " nodes, " << totalTime << " s, "
+              << U64(totalNodes / std::max(totalTime, 1e-9)) << " nodes/s" << std::endl;
+    return 0;
+}
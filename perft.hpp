@@ -0,0 +1,75 @@
+#pragma once
+
+#include <iostream>
+#include "chess.hpp"
+
+namespace Chess5D
+{
+  // Counts the leaf movesets reachable in `depth` half-turns. Every playable timeline of the side to move gets exactly
+  // one move per moveset and timelines are filled from the lowest index up, so each moveset is only counted once.
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  U64 perftMoveset(Chess<Set, Size, L, T> &chess, int depth)
+  {
+    const int timeline = chess.template playableTimeline<White>();
+    if (timeline < 0) // moveset complete
+      return depth == 1 ? 1 : perftMoveset<Set, Size, L, T, !White>(chess, depth - 1);
+
+    MoveList<> moves;
+    chess.template generateMoves<White>(moves, timeline);
+
+    // Bulk counting: moves on the last playable timeline of the last half-turn are leaves
+    if (depth == 1 && chess.template playableTimeline<White>(timeline + 1) < 0)
+      return moves.size();
+
+    U64 nodes = 0;
+    for (const Move &move : moves)
+    {
+      chess.template makeMove<White>(move);
+      nodes += perftMoveset<Set, Size, L, T, White>(chess, depth);
+      chess.template undoMove<White>(move);
+    }
+    return nodes;
+  }
+
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  U64 perft(Chess<Set, Size, L, T> &chess, int depth)
+  {
+    return depth <= 0 ? 1 : perftMoveset<Set, Size, L, T, White>(chess, depth);
+  }
+
+  // Prints the node count below every move of the first playable timeline and returns the total.
+  template <U8 Set, U8 Size, U16 L, U16 T, bool White>
+  U64 divide(Chess<Set, Size, L, T> &chess, int depth, std::ostream &os = std::cout)
+  {
+    const int timeline = chess.template playableTimeline<White>();
+    if (depth <= 0 || timeline < 0)
+      return perft<Set, Size, L, T, White>(chess, depth);
+
+    MoveList<> moves;
+    chess.template generateMoves<White>(moves, timeline);
+
+    U64 total = 0;
+    for (const Move &move : moves)
+    {
+      const std::string pgn = chess.template moveToPGN<White>(move);
+      chess.template makeMove<White>(move);
+      const U64 nodes = perftMoveset<Set, Size, L, T, White>(chess, depth);
+      chess.template undoMove<White>(move);
+
+      os << pgn << ": " << nodes << std::endl;
+      total += nodes;
+    }
+    os << "Total: " << total << std::endl;
+    return total;
+  }
+
+  // The side to move is the owner of the earliest headboard among the active timelines.
+  template <U8 Set, U8 Size, U16 L, U16 T>
+  bool whiteToMove(const Chess<Set, Size, L, T> &chess)
+  {
+    int present = chess.timelineInfo[chess.origIndex[0]].turn;
+    for (int i = chess.origIndex[1] - chess.activeNum[1]; i <= chess.origIndex[0] + chess.activeNum[0]; ++i)
+      present = std::min(present, int(chess.timelineInfo[i].turn));
+    return (present & 1) == 0;
+  }
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Chess5D
+{
+  // A node whose younger brothers are being searched by several threads. A beta cutoff at a split point, or at any split
+  // point above it, cancels every search running below it.
+  struct SplitPoint
+  {
+    const SplitPoint *parent = nullptr;
+    std::vector<const SplitPoint *> ancestors; // Itself and every split point above it
+    std::atomic<bool> cutoff{false};
+
+    // Whether this split point is `split` or lies below it
+    bool within(const SplitPoint *split) const { return std::find(ancestors.begin(), ancestors.end(), split) != ancestors.end(); }
+
+    bool cancelled() const
+    {
+      for (const SplitPoint *sp = this; sp; sp = sp->parent)
+        if (sp->cutoff.load(std::memory_order_relaxed))
+          return true;
+      return false;
+    }
+  };
+
+  // Work-stealing scheduler: every worker owns a deque, pushes to and pops from its back, and steals from the front of
+  // the others' when its own is empty. The thread that calls start() is worker 0, it only runs tasks while it waits for
+  // others, at a split point or at the root of a multiverse. A thread waiting at a split point only takes tasks of that
+  // split point or of those below it. A split point discards its tasks before it is destroyed, so those left in the
+  // deques only refer to split points still being searched.
+  class Scheduler
+  {
+    struct Task
+    {
+      const SplitPoint *split;
+      std::function<void()> run;
+    };
+
+    struct Worker
+    {
+      std::mutex lock;
+      std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<int> pending{0};
+    std::atomic<int> sleeping{0};
+    bool running = false;
+
+    static inline thread_local int self = 0;
+
+    // Takes the oldest or the newest task of a worker that lies within `split`, any task when it is null
+    bool pop(int id, bool front, const SplitPoint *split, Task &task)
+    {
+      Worker &worker = *workers[id];
+      std::lock_guard<std::mutex> guard(worker.lock);
+      for (int i = 0; i < worker.tasks.size(); ++i)
+      {
+        auto it = front ? worker.tasks.begin() + i : worker.tasks.end() - 1 - i;
+        if (split && (!it->split || !it->split->within(split)))
+          continue;
+        task = std::move(*it);
+        worker.tasks.erase(it);
+        --pending;
+        return true;
+      }
+      return false;
+    }
+
+    void loop(int id)
+    {
+      self = id;
+      while (true)
+      {
+        if (runOne())
+          continue;
+        std::unique_lock<std::mutex> lock(sleepLock);
+        ++sleeping;
+        wake.wait(lock, [&] { return !running || pending > 0; });
+        --sleeping;
+        if (!running)
+          return;
+      }
+    }
+
+  public:
+    ~Scheduler() { stop(); }
+
+    // Starts threads - 1 workers beside the calling thread
+    void start(int threads)
+    {
+      stop();
+      running = true;
+      for (int i = 0; i < threads; ++i)
+        workers.push_back(std::make_unique<Worker>());
+      for (int i = 1; i < threads; ++i)
+        this->threads.emplace_back(&Scheduler::loop, this, i);
+    }
+
+    void stop()
+    {
+      {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        running = false;
+      }
+      wake.notify_all();
+      for (std::thread &thread : threads)
+        thread.join();
+      threads.clear();
+      workers.clear();
+      pending = 0;
+    }
+
+    int size() const { return std::max<int>(1, workers.size()); }
+
+    // The worker the calling thread is, 0 for the thread that called start()
+    static int id() { return self; }
+
+    // Workers with nothing to do, tasks pushed beyond this are unlikely to be stolen soon
+    int idle() const { return sleeping.load(std::memory_order_relaxed); }
+
+    // Offers a task searching below `split`, null for one outside any split point
+    void push(const SplitPoint *split, std::function<void()> task)
+    {
+      {
+        Worker &worker = *workers[self];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.tasks.push_back({split, std::move(task)});
+      }
+      {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        ++pending;
+      }
+      wake.notify_one();
+    }
+
+    // Drops the tasks of `split` nobody has taken yet
+    void discard(const SplitPoint *split)
+    {
+      for (const std::unique_ptr<Worker> &worker : workers)
+      {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        const auto end = std::remove_if(worker->tasks.begin(), worker->tasks.end(), [&](const Task &task) { return task.split == split; });
+        pending -= worker->tasks.end() - end;
+        worker->tasks.erase(end, worker->tasks.end());
+      }
+    }
+
+    // Runs the newest task of this worker or steals the oldest of another, only among those within `split` unless it is
+    // null. Returns false when there was none.
+    bool runOne(const SplitPoint *split = nullptr)
+    {
+      Task task;
+      bool found = pop(self, false, split, task);
+      for (int i = 1; !found && i < workers.size(); ++i)
+        found = pop((self + i) % workers.size(), true, split, task);
+      if (found)
+        task.run();
+      return found;
+    }
+  };
+};
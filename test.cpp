@@ -1,5 +1,10 @@
 #include "ai.hpp"
+#include "perft.hpp"
+#include "positions.hpp"
 #include "gtest/gtest.h"
+#include <cstdio>
+#include <random>
+#include <set>
 
 
 // TEST(negaMax, SapphiaMateIn2) { //not actually mate in 2
@@ -49,8 +54,9 @@ TEST(negaMax, MageLosMateIn5) {
 
     chess.importPGN(pgn);
 
-    Chess5D::Result res = negaMax1<Set, Size, L, T, White>(chess,-1000000000,1000000000, 9, chess.origIndex[1], Chess5D::Move(0, 0, 0, 0, Chess5D::NullMove, 0, 0, 0, 0));
-    EXPECT_EQ(res.value, CHECKMATE);
+    Chess5D::SearchContext ctx(tt);
+    int res = negaMax1<Set, Size, L, T, White, true, Chess5D::NodeSpatial>(ctx, chess,-1000000000,1000000000, 9, 0, chess.origIndex[1], Chess5D::Move(0, 0, 0, 0, Chess5D::NullMove, 0, 0, 0, 0));
+    EXPECT_EQ(res, CHECKMATE);
 };
 
 TEST(negaMax, Perft) {
@@ -64,48 +70,417 @@ TEST(negaMax, Perft) {
     Chess5D::Chess<Set, Size, L, T> chess{};
     std::string fen = "[r*nbqk*bnr*/p*p*p*p*p*p*p*p*/8/8/8/8/P*P*P*P*P*P*P*P*/R*NBQK*BNR*:0:1:w]\n";
     chess.importFen(fen);
+    Chess5D::SearchContext ctx(tt);
 
-    count=0;
-    mates=0;
-
-    Chess5D::Result res = negaMax_Test<Set, Size, L, T, White>(chess, 1, chess.origIndex[1]);
+    Chess5D::Result res = negaMax_Test<Set, Size, L, T, White>(ctx, chess, 1, chess.origIndex[1]);
     EXPECT_EQ(res.value, 0);
-    EXPECT_EQ(count, 20);
-    EXPECT_EQ(mates, 0);
+    EXPECT_EQ(ctx.count, 20);
+    EXPECT_EQ(ctx.mates, 0);
 
-    count=0;
-    mates=0;
+    ctx.resetStats();
 
-    res = negaMax_Test<Set, Size, L, T, White>(chess, 2, chess.origIndex[1]);
+    res = negaMax_Test<Set, Size, L, T, White>(ctx, chess, 2, chess.origIndex[1]);
     EXPECT_EQ(res.value, 0);
-    EXPECT_EQ(count, 400);
-    EXPECT_EQ(mates, 0);
+    EXPECT_EQ(ctx.count, 400);
+    EXPECT_EQ(ctx.mates, 0);
 
-    count=0;
-    mates=0;
+    ctx.resetStats();
 
-    res = negaMax_Test<Set, Size, L, T, White>(chess, 3, chess.origIndex[1]);
+    res = negaMax_Test<Set, Size, L, T, White>(ctx, chess, 3, chess.origIndex[1]);
     EXPECT_EQ(res.value, 0);
-    EXPECT_EQ(count, 9822); //9822 actually but for now
-    EXPECT_EQ(mates, 0);
+    EXPECT_EQ(ctx.count, 9822); //9822 actually but for now
+    EXPECT_EQ(ctx.mates, 0);
 
-    count=0;
-    mates=0;
+    ctx.resetStats();
 
-    res = negaMax_Test<Set, Size, L, T, White>(chess, 4, chess.origIndex[1]);
+    res = negaMax_Test<Set, Size, L, T, White>(ctx, chess, 4, chess.origIndex[1]);
     EXPECT_EQ(res.value, 0);
-    EXPECT_GT(count, 197281); //not currently known
-    EXPECT_EQ(mates, 8);
+    EXPECT_GT(ctx.count, 197281); //not currently known
+    EXPECT_EQ(ctx.mates, 8);
 
-    count=0;
-    mates=0;
+    ctx.resetStats();
 
-    res = negaMax_Test<Set, Size, L, T, White>(chess, 5, chess.origIndex[1]);
+    res = negaMax_Test<Set, Size, L, T, White>(ctx, chess, 5, chess.origIndex[1]);
     EXPECT_EQ(res.value, 0);
-    EXPECT_GT(count, 4865609	); //not currently known
-    EXPECT_GT(mates,  3432);
+    EXPECT_GT(ctx.count, 4865609	); //not currently known
+    EXPECT_GT(ctx.mates,  3432);
+};
+
+TEST(perft, StartPosition) {
+    constexpr U8 Set = Chess5D::BPrincess;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    constexpr bool White = true;
+
+    Chess5D::Chess<Set, Size, L, T> chess{};
+    std::string fen = "[r*nbqk*bnr*/p*p*p*p*p*p*p*p*/8/8/8/8/P*P*P*P*P*P*P*P*/R*NBQK*BNR*:0:1:w]\n";
+    chess.importFen(fen);
+
+    EXPECT_EQ((perft<Set, Size, L, T, White>(chess, 1)), 20);
+    EXPECT_EQ((perft<Set, Size, L, T, White>(chess, 2)), 400);
+    EXPECT_EQ((perft<Set, Size, L, T, White>(chess, 3)), 9822);
+};
+
+TEST(generate, QuietChecks) {
+    constexpr U8 Set = Chess5D::BPrincess;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    // d4d5 uncovers the bishop on the long diagonal
+    Chess5D::Chess<Set, Size, L, T> chess{};
+    chess.importFen("[K6k/8/8/8/3P4/8/8/B7:0:1:w]\n");
+    const int timeline = chess.origIndex[1];
+
+    MoveList<> all, checks;
+    chess.template generateMoves<true>(all, timeline);
+    chess.template generateMoves<true, Chess5D::GenQuietChecks>(checks, timeline);
+
+    int quietChecks = 0;
+    for (const Move &move : all)
+    {
+        const bool quiet = move.type == Normal || move.type == Push || move.type == Promotion;
+        if (quiet && chess.template givesCheck<true>(move))
+        {
+            ++quietChecks;
+            EXPECT_NE(std::find(checks.begin(), checks.end(), move), checks.end()) << chess.template moveToPGN<true>(move);
+        }
+    }
+    EXPECT_EQ(quietChecks, 1);
+};
+
+TEST(move, Encoding) {
+    const Move move(12, 28, WQueen, 0, TravelPromotion, 17, 40, 15, 36);
+    EXPECT_EQ(sizeof(Move), sizeof(U64));
+
+    const Move decoded = Move::decode(move.encode());
+    EXPECT_EQ(decoded, move);
+    EXPECT_EQ(decoded.special1, WQueen);
+    EXPECT_EQ(decoded.type, TravelPromotion);
+    EXPECT_EQ(decoded.eTurn, 36);
+    EXPECT_NE(move, Move(12, 28, WKnight, 0, TravelPromotion, 17, 40, 15, 36));
+};
+
+TEST(hash, Incremental) {
+    constexpr U8 Set = Chess5D::BPrincess;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    Chess5D::Chess<Set, Size, L, T> chess{};
+    std::string fen = "[r*nbqk*bnr*/p*p*p*p*p*p*p*p*/8/8/8/8/P*P*P*P*P*P*P*P*/R*NBQK*BNR*:0:1:w]\n";
+    chess.importFen(fen);
+    const int timeline = chess.origIndex[1];
+    const int turn = chess.timelineInfo[timeline].turn;
+    const U64 start = chess.boards[timeline][turn].board.hash;
+    const U64 multiverse = chess.hash;
+    EXPECT_EQ(multiverse, chess.fullHash());
+
+    MoveList<> moves;
+    chess.template generateMoves<true>(moves, timeline);
+    for (const Move &move : moves)
+    {
+        chess.template makeMove<true>(move);
+        const Board<Set> &brd = chess.boards[timeline][turn + 1];
+        EXPECT_EQ(brd.board.hash, brd.fullHash());
+        EXPECT_NE(brd.board.hash, start);
+        EXPECT_EQ(chess.hash, chess.fullHash());
+        chess.template undoMove<true>(move);
+        EXPECT_EQ(chess.hash, multiverse);
+    }
+
+    // Knights out and back transpose to the start position
+    const U8 knightMoves[4][2] = {{6, 21}, {62, 45}, {21, 6}, {45, 62}};
+    for (int i = 0; i < 4; ++i)
+    {
+        const Move move(knightMoves[i][0], knightMoves[i][1], 0, 0, Normal, timeline, turn + i, 0, 0);
+        i % 2 ? chess.template makeMove<false>(move) : chess.template makeMove<true>(move);
+    }
+    EXPECT_EQ(chess.boards[timeline][turn + 4].board.hash, start);
+    EXPECT_NE(chess.hash, multiverse); // Same board, but four more of them in the multiverse
+
+    // The en passant target of c7c5 is dropped as bxc6 would expose the king, the key leaves it out as well
+    Chess5D::Chess<Set, Size, L, T> pinned{};
+    pinned.importFen("[4k3/2p*5/8/KP5r/8/8/8/8:0:1:b]\n");
+    const int pinnedTurn = pinned.timelineInfo[timeline].turn;
+    const U64 before = pinned.hash;
+    const Move push(50, 34, 0, 0, Push, timeline, pinnedTurn, 0, 0);
+    pinned.template makeMove<false>(push);
+    EXPECT_EQ(pinned.boards[timeline][pinnedTurn + 1].board.epTarget, EMPTY);
+    EXPECT_EQ(pinned.hash, pinned.fullHash());
+    pinned.template undoMove<false>(push);
+    EXPECT_EQ(pinned.hash, before);
+};
+
+TEST(nnue, IncrementalLayer) {
+    constexpr U8 Set = Chess5D::BPrincess;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    // Random weights, small enough that sums of a few dozen inputs stay within 16 bits
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> weight(-64, 64), output(-127, 127);
+    auto network = std::make_unique<Chess5D::Network>();
+    for (int i = 0; i < Chess5D::NNUE_LANES; ++i)
+        for (int j = 0; j < 32; ++j)
+        {
+            network->hiddenBias.lanes[i][j] = weight(rng);
+            network->outputWeights[i][j] = output(rng);
+            for (int k = 0; k < Chess5D::NNUE_INPUTS; ++k)
+                network->hiddenWeights[k].lanes[i][j] = weight(rng);
+        }
+    network->outputBias = 1000;
+
+    const std::string path = testing::TempDir() + "test.nnue";
+    ASSERT_TRUE(network->save(path));
+    auto loaded = std::make_unique<Chess5D::Network>();
+    ASSERT_TRUE(loaded->load(path));
+    std::remove(path.c_str());
+
+    Chess5D::Chess<Set, Size, L, T> chess{};
+    std::string fen = "[r*nbqk*bnr*/p*p*p*p*p*p*p*p*/8/8/8/8/P*P*P*P*P*P*P*P*/R*NBQK*BNR*:0:1:w]\n";
+    chess.importFen(fen);
+    const int timeline = chess.origIndex[1];
+    const Board<Set> &brd = chess.boards[timeline][chess.timelineInfo[timeline].turn];
+
+    Chess5D::HiddenLayer start, layer;
+    network->refresh(start, brd.board.mailboxBoard);
+    loaded->refresh(layer, brd.board.mailboxBoard);
+    EXPECT_EQ(network->evaluate(start, 0, 0), loaded->evaluate(layer, 0, 0));
+    EXPECT_NE(network->evaluate(start, 0, 0), network->evaluate(start, 0, 1));
+
+    // Removing the pieces a move lifts and adding the ones it places matches a full recompute
+    MoveList<> moves;
+    chess.template generateMoves<true>(moves, timeline);
+    for (const Move &move : moves)
+    {
+        chess.template makeMove<true>(move);
+        const Board<Set> &next = chess.boards[timeline][chess.timelineInfo[timeline].turn];
+        Chess5D::HiddenLayer incremental = start, full;
+        for (int sq = 0; sq < 64; ++sq)
+            if (brd.board.mailboxBoard[sq] != next.board.mailboxBoard[sq])
+            {
+                if (brd.board.mailboxBoard[sq] != Chess5D::NoPiece)
+                    network->update<-1>(incremental, Chess5D::pieceFeature(brd.board.mailboxBoard[sq], sq));
+                if (next.board.mailboxBoard[sq] != Chess5D::NoPiece)
+                    network->update<1>(incremental, Chess5D::pieceFeature(next.board.mailboxBoard[sq], sq));
+            }
+        network->refresh(full, next.board.mailboxBoard);
+        EXPECT_EQ(network->evaluate(incremental, 0, 0), network->evaluate(full, 0, 0));
+        chess.template undoMove<true>(move);
+    }
+
+#ifdef NNUE
+    // The layer the boards themselves keep matches a full recompute after every kind of move
+    auto saved = std::make_unique<Chess5D::Network>(Chess5D::network);
+    Chess5D::network = *network;
+
+    // Plays every move of `type` (travels for Travel) White has, comparing the head board of each timeline after it
+    const auto expectLayers = [](Chess5D::Chess<Set, Size, L, T> &position, Chess5D::MoveType type)
+    {
+        const int origin = position.template playableTimeline<true>();
+        MoveList<> moves;
+        position.template generateMoves<true>(moves, origin);
+        int played = 0;
+        for (const Move &move : moves)
+        {
+            if (type == Chess5D::Travel ? move.type < Chess5D::Travel : move.type != type)
+                continue;
+            ++played;
+            position.template makeMove<true>(move);
+            for (int t = position.origIndex[1] - position.timelineNum[1]; t <= position.origIndex[0] + position.timelineNum[0]; ++t)
+            {
+                const Board<Set> &head = position.boards[t][position.timelineInfo[t].turn];
+                Chess5D::HiddenLayer full;
+                Chess5D::network.refresh(full, head.board.mailboxBoard);
+                EXPECT_EQ(std::memcmp(&full, &head.board.hidden, sizeof(full)), 0) << position.template moveToPGN<true>(move);
+            }
+            position.template undoMove<true>(move);
+        }
+        EXPECT_GT(played, 0) << int(type);
+    };
+
+    // Boards made before the network was swapped keep the old layer, so every position is imported afterwards
+    auto position = std::make_unique<Chess5D::Chess<Set, Size, L, T>>();
+    position->importFen(fen);
+    expectLayers(*position, Chess5D::Normal);
+    expectLayers(*position, Chess5D::Push);
+
+    position = std::make_unique<Chess5D::Chess<Set, Size, L, T>>();
+    position->importFen("[r*3k*2r*/8/8/8/8/8/8/R*3K*2R*:0:1:w]\n");
+    expectLayers(*position, Chess5D::Castle);
+
+    position = std::make_unique<Chess5D::Chess<Set, Size, L, T>>();
+    position->importFen("[4k3/2p*5/8/1P6/8/8/8/4K3:0:1:b]\n");
+    const int epTurn = position->timelineInfo[timeline].turn;
+    position->template makeMove<false>(Move(50, 34, 0, 0, Push, timeline, epTurn, 0, 0));
+    expectLayers(*position, Chess5D::Enpassant);
+
+    // Knights out on both sides leave past boards for White's knight to travel to
+    position = std::make_unique<Chess5D::Chess<Set, Size, L, T>>();
+    position->importFen(fen);
+    const int travelTurn = position->timelineInfo[timeline].turn;
+    position->template makeMove<true>(Move(6, 21, 0, 0, Normal, timeline, travelTurn, 0, 0));
+    position->template makeMove<false>(Move(62, 45, 0, 0, Normal, timeline, travelTurn + 1, 0, 0));
+    expectLayers(*position, Chess5D::Travel);
+
+    Chess5D::network = *saved;
+#endif
+};
+
+TEST(tt, Snapshot) {
+    TranspositionTable table(1);
+    TTEntry entry;
+    for (int i = 1; i <= 1000; ++i)
+    {
+        entry.key = U64(i) * 0x9E3779B97F4A7C15ull;
+        entry.depth = i % 16;
+        entry.value = i;
+        table.store(entry);
+    }
+
+    // Loading replaces the size too, and the loaded table can be written back over its own file
+    const std::string path = testing::TempDir() + "test.tt";
+    ASSERT_TRUE(table.save(path));
+    TranspositionTable loaded(2);
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.mask, table.mask);
+    entry.key = 1001 * 0x9E3779B97F4A7C15ull;
+    loaded.store(entry);
+    ASSERT_TRUE(loaded.save(path));
+
+    TranspositionTable reloaded(1);
+    ASSERT_TRUE(reloaded.load(path));
+    for (int i = 1; i <= 1001; ++i)
+    {
+        const U64 key = U64(i) * 0x9E3779B97F4A7C15ull;
+        EXPECT_EQ(reloaded.probe(key).key == key, table.probe(key).key == key || i == 1001);
+    }
+
+    // Keys made from another seed would never match
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        const U64 seed = Chess5D::zobrist.seed + 1;
+        file.seekp(offsetof(TTSnapshotHeader, seed));
+        file.write(reinterpret_cast<const char *>(&seed), sizeof(seed));
+    }
+    EXPECT_FALSE(reloaded.load(path));
+    EXPECT_EQ(reloaded.probe(1001 * 0x9E3779B97F4A7C15ull).key, 1001 * 0x9E3779B97F4A7C15ull);
+    std::remove(path.c_str());
+    EXPECT_FALSE(reloaded.load(path));
 };
 
+TEST(search, ConcurrentContexts) {
+    constexpr U8 Set = Chess5D::BPrincess;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    // Each search has its own position, table, evaluation cache and context, so running them side by side changes nothing
+    auto search = [](int &value, U64 &nodes)
+    {
+        auto chess = std::make_unique<Chess5D::Chess<Set, Size, L, T>>();
+        std::string fen = "[r*nbqk*bnr*/p*p*p*p*p*p*p*p*/8/8/8/8/P*P*P*P*P*P*P*P*/R*NBQK*BNR*:0:1:w]\n";
+        chess->importFen(fen);
+        TranspositionTable table(1);
+        EvalCache cache(1);
+        Chess5D::SearchContext ctx(table, cache);
+        value = negaMax1<Set, Size, L, T, true, true, Chess5D::NodeSpatial>(ctx, *chess, -CHECKMATE, CHECKMATE, 3, 0, chess->origIndex[1], Chess5D::Move(0, 0, 0, 0, Chess5D::NullMove, 0, 0, 0, 0));
+        nodes = ctx.nodes;
+    };
+
+    int value, values[2];
+    U64 nodes, counts[2];
+    search(value, nodes);
+    std::thread first(search, std::ref(values[0]), std::ref(counts[0]));
+    std::thread second(search, std::ref(values[1]), std::ref(counts[1]));
+    first.join();
+    second.join();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        EXPECT_EQ(values[i], value);
+        EXPECT_EQ(counts[i], nodes);
+    }
+};
+
+// Value of a fixed depth search of a predefined position, on a table and cache of its own
+int searchPosition(int position, int depth, int threads, Chess5D::ParallelMode mode) {
+    constexpr U8 Set = Chess5D::NoPiece;
+    constexpr U8 Size = 8;
+    constexpr U16 L = 32;
+    constexpr U16 T = 128;
+
+    auto chess = std::make_unique<Chess5D::Chess<Set, Size, L, T>>();
+    Positions::load(*chess, position);
+    TranspositionTable table(16);
+    EvalCache cache(1);
+    Chess5D::SearchContext ctx(table, cache);
+    const Chess5D::SearchLimits limits{depth};
+    return whiteToMove(*chess) ? negaMaxIDDFS<Set, Size, L, T, true>(ctx, *chess, limits, threads, mode).value
+                               : negaMaxIDDFS<Set, Size, L, T, false>(ctx, *chess, limits, threads, mode).value;
+}
+
+TEST(search, YoungBrothersWait) {
+    // Position 3 has a mate the search finds at depth 6, however the brothers are spread over the workers
+    const int value = searchPosition(3, 6, 1, Chess5D::ParallelYBW);
+    EXPECT_GT(value, CHECKMATE - Chess5D::MAX_PLY);
+    for (int threads : {2, 4})
+        EXPECT_EQ(searchPosition(3, 6, threads, Chess5D::ParallelYBW), value) << threads << " threads";
+};
+
+TEST(search, LazySMP) {
+    // Helpers store entries searched with other reductions, and at depth 6 the main search sometimes takes one that
+    // missed the mate. From depth 7 every thread count finds it.
+    const int value = searchPosition(3, 7, 1, Chess5D::ParallelLazySMP);
+    EXPECT_GT(value, CHECKMATE - Chess5D::MAX_PLY);
+    for (int threads : {2, 4})
+        EXPECT_EQ(searchPosition(3, 7, threads, Chess5D::ParallelLazySMP), value) << threads << " threads";
+};
+
+TEST(search, ParallelTimelines) {
+    // Position 6 has several timelines, which the threads search side by side whatever the mode
+    const int value = searchPosition(6, 3, 1, Chess5D::ParallelLazySMP);
+    EXPECT_GT(value, CHECKMATE - Chess5D::MAX_PLY);
+    for (int threads : {2, 4})
+        EXPECT_EQ(searchPosition(6, 3, threads, Chess5D::ParallelLazySMP), value) << threads << " threads";
+};
+
+TEST(search, MovesetEnumerator) {
+    // Three timelines, the last has a single move within the margin of its best
+    std::vector<Chess5D::TimelineMoves> timelines(3);
+    const int scores[3][4] = {{10, 8, 5, 1}, {4, 3, 0, -2}, {7, 7 - Chess5D::MOVESET_MARGIN - 1, -50, -60}};
+    for (int t = 0; t < 3; ++t)
+        for (int i = 0; i < 4; ++i)
+        {
+            timelines[t].moves.emplace_back(t * 8 + i, 0, 0, 0, Normal, t, 0, 0, 0);
+            timelines[t].scores.push_back(scores[t][i]);
+        }
+
+    Chess5D::MovesetEnumerator movesets(timelines);
+    std::vector<Move> moveset;
+    std::set<std::vector<U8>> seen;
+    int last = INT_MAX;
+    while (movesets.next(moveset))
+    {
+        ASSERT_EQ(moveset.size(), 3);
+        int score = 0;
+        std::vector<U8> tuple;
+        for (int t = 0; t < 3; ++t)
+        {
+            tuple.push_back(moveset[t].from - t * 8);
+            score += scores[t][tuple.back()];
+        }
+        EXPECT_LE(score, last); // Best first
+        last = score;
+        EXPECT_TRUE(seen.insert(tuple).second); // Each moveset once
+        EXPECT_EQ(tuple[2], 0);
+    }
+    EXPECT_EQ(seen.size(), 4 * 4 * 1);
+};
 
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -1,14 +1,20 @@
 #include "chess.hpp"
-#include <random>
+#include <atomic>
+#include <climits>
+#include <fstream>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace Chess5D;
 
-// Constants for board representation (example for chess)
-const int RANKS=8;
-const int FILES=8;
-const int NUM_SQS = RANKS*FILES;  
-const int PIECE_TYPES = 24;
-
 struct TTEntry {
     enum Flag { EXACT, LOWERBOUND, UPPERBOUND };
 
@@ -23,97 +29,267 @@ struct TTEntry {
     TTEntry() : key(0), depth(0), value(0), flag(0) {}
 };
 
+// A TTEntry as it is stored, the lower key bits are implied by the bucket. Search threads share the table without
+// locks, so every word is accessed atomically and `check` is XORed with the others: a slot torn by two concurrent stores
+// fails verification instead of returning a mix of both.
+struct TTSlot {
+    U32 check;      // Upper half of the key ^ value ^ move[0] ^ move[1] ^ info
+    U32 value;
+    U32 move[2];
+    U32 info;       // Depth, flag, side and quiescence bits, then the search generation (0 for an empty slot)
+
+    static U32 load(const U32 &word) { return std::atomic_ref<U32>(const_cast<U32 &>(word)).load(std::memory_order_relaxed); }
+    static void save(U32 &word, const U32 data) { std::atomic_ref<U32>(word).store(data, std::memory_order_relaxed); }
+};
+
+struct alignas(64) TTBucket {
+    static constexpr int SLOTS = 3;
+    TTSlot slots[SLOTS];
+};
+static_assert(sizeof(TTBucket) == 64);
+
+// Leads a table snapshot, the buckets follow as they are in memory. Keys only mean something under the Zobrist keys
+// they were computed with, so a snapshot is only loaded by a process with the same seed.
+struct alignas(64) TTSnapshotHeader {
+    static constexpr U32 MAGIC = 0x54544435; // "5DTT"
+    static constexpr U32 VERSION = 2;        // Raised whenever TTBucket, TTSlot or the Zobrist key order change
+
+    U32 magic = MAGIC;
+    U32 version = VERSION;
+    U64 seed;
+    U64 buckets;
+    U8 generation;
+};
+static_assert(sizeof(TTSnapshotHeader) == sizeof(TTBucket));
+
+// A file mapped copy-on-write: pages are read in when first touched and writes never reach the file
+struct MappedFile {
+    char *data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&other) {
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+        return *this;
+    }
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER length;
+        HANDLE mapping = GetFileSizeEx(file, &length) && length.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+        void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+        if (mapping)
+            CloseHandle(mapping); // The view keeps the mapping alive
+        CloseHandle(file);
+        if (!view)
+            return false;
+        size = size_t(length.QuadPart);
+#else
+        const int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat info;
+        void *view = fstat(file, &info) == 0 && info.st_size > 0 ? mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0) : MAP_FAILED;
+        ::close(file); // The mapping keeps the file alive
+        if (view == MAP_FAILED)
+            return false;
+        size = size_t(info.st_size);
+#endif
+        data = static_cast<char *>(view);
+        return true;
+    }
+
+    void close() {
+        if (!data)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+};
+
 struct TranspositionTable { 
-    std::unordered_map<U64,TTEntry> table;
-
-    // Zobrist hash keys
-    struct Zobrist{
-        U64 piece[NUM_SQS][PIECE_TYPES];
-        U64 color[2];
-        U64 ep[FILES]; //Considers that pawns cant start on anything besides second rank
-        U64 unmoved[NUM_SQS];
-        U64 past[NUM_SQS];
-    } zobrist;
-    
-
-    // Random number generator for Zobrist hashing
-    std::mt19937_64 rng;
-
-    TranspositionTable(size_t size) {
-        table.reserve(size);
-
-        // Initialize random number generator for Zobrist hashing
-        std::random_device rd;
-        auto rand=rd();
-        std::cout<<rand<<std::endl;
-        rng.seed(rand);
-
-        // Initialize Zobrist keys
-        initZobristKeys();
-    }
-
-    // Initialize Zobrist keys with random numbers
-    void initZobristKeys() {
-        std::uniform_int_distribution<uint64_t> dist(0, UINT64_MAX);
-        zobrist.color[0] = dist(rng);
-        zobrist.color[1] = dist(rng);
-        for (int sq = 0; sq < NUM_SQS; ++sq) {
-            for (int piece = 0; piece < PIECE_TYPES; ++piece) {
-                zobrist.piece[sq][piece] = dist(rng);
-            }
-            zobrist.unmoved[sq] = dist(rng);
-            zobrist.past[sq] = dist(rng);
-        }
-        for (int file = 0; file < FILES; ++file) {
-            zobrist.ep[file]=dist(rng);
-        }
+    TTBucket *table;    // The buckets in `owned`, or in `snapshot` once one is loaded
+    U64 mask;           // Bucket count - 1
+    U8 generation = 1;
+
+    // Zobrist hash keys, shared with the boards that hash themselves incrementally
+    Zobrist &zobrist = Chess5D::zobrist;
+
+    // Takes the largest power of two number of buckets that fits in `megabytes`
+    TranspositionTable(size_t megabytes) {
+        const size_t buckets = std::bit_floor(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(TTBucket), 1));
+        owned.resize(buckets);
+        table = owned.data();
+        mask = buckets - 1;
     }
 
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+
     // Clear the transposition table
     void clear() {
-        table.clear();
-    }
-
-    // Compute Zobrist hash key for the current board position
-    template <U8 Set, bool White>
-    U64 computeHashKey(const Board<Set>& brd) { //Should maybe include enpassant in initialization
-        U64 key = 0;
-        key ^=zobrist.color[(int)White];
-        for (int sq = 0; sq < NUM_SQS; ++sq) {
-            int piece = brd.board.mailboxBoard[sq]; // Example function to get piece at square
-            if (piece != NoPiece) { // Assuming EMPTY is defined
-                key ^= zobrist.piece[sq][piece];
-            }
+        std::fill(table, table + mask + 1, TTBucket{});
+        generation = 1;
+    }
+
+    // Writes the table to `path`, see TTSnapshotHeader. Not meant to run while a search stores entries. A loaded snapshot
+    // is copied into memory first, its file may be the one being written.
+    bool save(const std::string &path) {
+        if (snapshot.data) {
+            owned.assign(table, table + mask + 1);
+            table = owned.data();
+            snapshot.close();
         }
-        U64 epTarget=brd.board.epTarget;
-        Bitloop(epTarget)
-        {
-            const U8 ep = SquareOf(epTarget);
-            key ^=zobrist.ep[ep%FILES];
+
+        TTSnapshotHeader header;
+        header.seed = zobrist.seed;
+        header.buckets = mask + 1;
+        header.generation = generation;
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(table), (mask + 1) * sizeof(TTBucket));
+        return bool(file);
+    }
+
+    // Continues from a snapshot, which may have another size than the table. The file is mapped rather than read, so
+    // loading costs nothing up front and only the buckets a search touches are ever read from disk. Returns false,
+    // leaving the table as it was, when the file is missing, of another version or made under other Zobrist keys.
+    bool load(const std::string &path) {
+        MappedFile file;
+        if (!file.open(path) || file.size < sizeof(TTSnapshotHeader))
+            return false;
+        const TTSnapshotHeader &header = *reinterpret_cast<const TTSnapshotHeader *>(file.data);
+        if (header.magic != TTSnapshotHeader::MAGIC || header.version != TTSnapshotHeader::VERSION || header.seed != zobrist.seed ||
+            !std::has_single_bit(header.buckets) || file.size != sizeof(header) + header.buckets * sizeof(TTBucket))
+            return false;
+
+        table = reinterpret_cast<TTBucket *>(file.data + sizeof(header));
+        mask = header.buckets - 1;
+        generation = header.generation;
+        snapshot = std::move(file);
+        owned = std::vector<TTBucket>();
+        return true;
+    }
+
+    // Entries of earlier searches are replaced first
+    void newSearch() {
+        generation = generation == 255 ? 1 : generation + 1;
+    }
+
+    // Compute Zobrist hash key for the whole multiverse, searched on `timeline` by the given side
+    template <bool White, U8 Set, U8 Size, U16 L, U16 T>
+    U64 computeHashKey(const Chess<Set, Size, L, T>& chess, int timeline) {
+#ifdef HASH_CHECK
+        if (chess.hash != chess.fullHash()) {
+            std::cerr << "Incremental multiverse hash mismatch" << std::endl;
+            std::abort();
         }
-        U64 unmoved=brd.board.unmoved&(brd.bitBoard(true, King)|brd.bitBoard(false, King)|brd.bitBoard(true, Rook)|brd.bitBoard(false, Rook));
-        Bitloop(unmoved)
-        {
-            const U8 um = SquareOf(unmoved);
-            key ^=zobrist.unmoved[um];
+#endif
+        return zobrist.color[(int)White] ^ zobrist.timeline[timeline] ^ chess.hash;
+    }
+
+    // Retrieve an entry from the transposition table, a default entry (key 0) on a miss
+    TTEntry probe(U64 key) const {
+        const TTBucket &bucket = table[key & mask];
+        for (const TTSlot &slot : bucket.slots) {
+            const U32 value = TTSlot::load(slot.value);
+            const U32 move0 = TTSlot::load(slot.move[0]);
+            const U32 move1 = TTSlot::load(slot.move[1]);
+            const U32 info = TTSlot::load(slot.info);
+            if ((info >> 16) && (TTSlot::load(slot.check) ^ value ^ move0 ^ move1 ^ info) == U32(key >> 32)) {
+                TTEntry entry;
+                entry.key = key;
+                entry.move = Move::decode(U64(move1) << 32 | move0);
+                entry.depth = int8_t(info);
+                entry.flag = info >> 8 & 3;
+                entry.isWhite = info >> 10 & 1;
+                entry.isQSearch = info >> 11 & 1;
+                entry.value = int(value);
+                return entry;
+            }
         }
-        U64 past=brd.pastMask.center | brd.pastMask.north | brd.pastMask.south | brd.pastMask.northeast | brd.pastMask.southeast | brd.pastMask.southwest | brd.pastMask.northwest;
-        Bitloop(past)
-        {
-            const U8 pst = SquareOf(past);
-            key ^=zobrist.past[pst];
+        return TTEntry();
+    }
+
+    // Store an entry in the transposition table. It replaces the entry of the same position, otherwise the slot
+    // with the lowest depth, counting entries of older searches as shallower.
+    void store(const TTEntry& entry) {
+        TTBucket &bucket = table[entry.key & mask];
+        const U32 upper = U32(entry.key >> 32);
+        TTSlot *replace = &bucket.slots[0];
+        int replaceWorth = INT_MAX;
+        for (TTSlot &slot : bucket.slots) {
+            const U32 info = TTSlot::load(slot.info);
+            const U32 check = TTSlot::load(slot.check) ^ TTSlot::load(slot.value) ^ TTSlot::load(slot.move[0]) ^ TTSlot::load(slot.move[1]) ^ info;
+            if (!(info >> 16) || check == upper) {
+                replace = &slot;
+                break;
+            }
+            if (worth(info) < replaceWorth) {
+                replace = &slot;
+                replaceWorth = worth(info);
+            }
         }
-        return key;
+
+        const U64 move = entry.move.encode();
+        const U32 info = U8(std::clamp(entry.depth, -128, 127)) | U32(entry.flag) << 8 | U32(entry.isWhite) << 10 |
+                         U32(entry.isQSearch) << 11 | U32(generation) << 16;
+        TTSlot::save(replace->value, U32(entry.value));
+        TTSlot::save(replace->move[0], U32(move));
+        TTSlot::save(replace->move[1], U32(move >> 32));
+        TTSlot::save(replace->info, info);
+        TTSlot::save(replace->check, upper ^ U32(entry.value) ^ U32(move) ^ U32(move >> 32) ^ info);
     }
 
-    // Retrieve an entry from the transposition table
-    TTEntry& probe(U64 key) {
-        TTEntry& entry = table[key];
-        return entry;
+private:
+    std::vector<TTBucket> owned;
+    MappedFile snapshot;
+
+    int worth(const U32 info) const {
+        return int8_t(info) - 4 * U8(generation - (info >> 16));
     }
+};
 
-    // Store an entry in the transposition table
-    void store(const TTEntry& entry) {
-        table[entry.key] = entry;
+// Direct-mapped cache of static evaluations, keyed like the transposition table. An entry is a single word holding the
+// upper half of the key over the score, so threads share it without locks and a racing store replaces an entry whole.
+struct EvalCache {
+    std::vector<U64> table;
+    U64 mask;       // Entry count - 1
+
+    // Takes the largest power of two number of entries that fits in `megabytes`
+    EvalCache(size_t megabytes) {
+        const size_t entries = std::bit_floor(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(U64), 1));
+        table.resize(entries);
+        mask = entries - 1;
+    }
+
+    void clear() {
+        std::fill(table.begin(), table.end(), 0);
+    }
+
+    // Writes the cached score of `key` to `value`, returns false on a miss
+    bool probe(U64 key, int &value) const {
+        const U64 entry = std::atomic_ref<U64>(const_cast<U64 &>(table[key & mask])).load(std::memory_order_relaxed);
+        if (entry == 0 || U32(entry >> 32) != U32(key >> 32))
+            return false;
+        value = int(U32(entry));
+        return true;
+    }
+
+    void store(U64 key, int value) {
+        std::atomic_ref<U64>(table[key & mask]).store(key >> 32 << 32 | U32(value), std::memory_order_relaxed);
     }
 };
\ No newline at end of file